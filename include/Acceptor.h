@@ -20,19 +20,44 @@ public:
     newConnectionCallback_ = cb; // TcpServer::newConnection
   }
 
+  EventLoop *getLoop() const { return loop_; }
   bool listenning() const { return listenning_; }
   void listen();
+  // 监听 socket 实际绑定的地址，端口为 0 时可以得到内核分配的端口
+  InetAddress localAddress() const;
+
+  /* 以下设置必须在 listen() 之前调用 */
+
+  // 每次可读事件最多 accept 的连接数，默认 kDefaultAcceptBatch
+  void setAcceptBatch(int batch) { acceptBatch_ = batch > 0 ? batch : 1; }
+  /* accept4 的 flags，默认 SOCK_NONBLOCK | SOCK_CLOEXEC；
+   * 连接必须是非阻塞的，SOCK_NONBLOCK 总会加上 */
+  void setAcceptFlags(int flags) { acceptFlags_ = flags; }
+  // 监听 socket 的 TCP_DEFER_ACCEPT，单位为秒，0 表示不启用(默认)
+  void setDeferAccept(int seconds) { deferAcceptSeconds_ = seconds; }
+
+  static const int kDefaultAcceptBatch = 64;
 
 private:
   /* 1. 从 listenfd 上 accept 新的连接
    * 2. 将新连接的 fd 设置为非阻塞模式
    * 3. 将新连接加入到 SubReactor 的 EventLoop 中 */
   void handleRead();
+  // 文件描述符用完时，借用 idleFd_ 接受并立即关闭一个连接
+  void shedConnection();
 
-  EventLoop *loop_; // Acceptor 用的是用户定义的 baseLoop(即 mainLoop)
+  /* Acceptor 用的是用户定义的 baseLoop(即 mainLoop)，
+   * TcpServer::kReusePortPerLoop 模式下是各个 subLoop */
+  EventLoop *loop_;
   Socket acceptSocket_;
   Channel acceptChannel_; // 要注册到 Poller 中
   // 负责将新连接分发给 subLoop，会被 TcpServer 的 newConnection() 方法调用
   NewConnectionCallback newConnectionCallback_;
   bool listenning_;
+  int acceptBatch_;
+  int acceptFlags_;
+  int deferAcceptSeconds_;
+  /* 预留的空闲 fd(打开 /dev/null)。EMFILE 时水平触发的 listenfd
+   * 会一直可读，先关闭它腾出一个 fd 把连接接受下来再关闭，然后重新占住 */
+  int idleFd_;
 };
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Thread.h"
+#include "noncopyable.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/*
+ * Asynchronous logging backend with double buffering.
+ *
+ * 1. 前端(任意线程)调用 append，在锁内把日志 memcpy 到当前缓冲区，
+ *    不做任何文件 I/O；当前缓冲区写满时换上备用缓冲区，并通知后台线程
+ * 2. 后台线程每隔 flushInterval 秒或者被通知时，与前端交换整批缓冲区，
+ *    在锁外写入 LogFile，写完的缓冲区归还给前端复用
+ * 3. 前端写入过快导致积压的缓冲区过多时，丢弃多余的日志并记录一条提示
+ *
+ * 使用方法：
+ *   AsyncLogging log("/tmp/server", 500 * 1000 * 1000);
+ *   log.start();
+ *   Logger::instance().setOutput(std::bind(&AsyncLogging::append, &log,
+ *                                          std::placeholders::_1,
+ *                                          std::placeholders::_2));
+ *   Logger::instance().setFlush(std::bind(&AsyncLogging::flush, &log));
+ */
+class AsyncLogging : noncopyable {
+public:
+  AsyncLogging(const std::string &basename, off_t rollSize,
+               int flushInterval = 3);
+  ~AsyncLogging();
+
+  // Thread safe. 只拷贝内存，不会进行系统调用
+  void append(const char *logline, int len);
+
+  /* Thread safe. 阻塞到此前 append 的日志都写入文件并 fflush，
+   * 用于 LOG_FATAL 退出之前 */
+  void flush();
+
+  void start();
+  void stop(); // 写完所有缓冲的日志之后退出后台线程
+
+private:
+  // 固定大小的日志缓冲区
+  class LogBuffer : noncopyable {
+  public:
+    static const size_t kSize = 4 * 1024 * 1024;
+
+    LogBuffer() : cur_(data_) {}
+
+    void append(const char *buf, size_t len) {
+      memcpy(cur_, buf, len);
+      cur_ += len;
+    }
+    const char *data() const { return data_; }
+    size_t length() const { return static_cast<size_t>(cur_ - data_); }
+    size_t avail() const { return static_cast<size_t>(end() - cur_); }
+    void reset() { cur_ = data_; }
+
+  private:
+    const char *end() const { return data_ + sizeof data_; }
+
+    char data_[kSize];
+    char *cur_;
+  };
+
+  using BufferPtr = std::unique_ptr<LogBuffer>;
+  using BufferVector = std::vector<BufferPtr>;
+
+  void threadFunc();
+
+  const int flushInterval_;
+  const std::string basename_;
+  const off_t rollSize_;
+  std::atomic_bool running_;
+  Thread thread_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;      // 通知后台线程有写满的缓冲区
+  std::condition_variable flushCond_; // 通知 flush() 的调用者已经写完
+  BufferPtr currentBuffer_; // 前端正在写的缓冲区
+  BufferPtr nextBuffer_;    // 前端的备用缓冲区
+  BufferVector buffers_;    // 等待后台线程写入文件的缓冲区
+  int64_t flushRequested_;  // flush() 请求的序号
+  int64_t flushCompleted_;  // 后台线程已经完成的 flush 序号
+};
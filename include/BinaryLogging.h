@@ -0,0 +1,142 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+
+/*
+ * Binary deferred-formatting log backend.
+ *
+ * 1. 每个 LOG_* 调用点第一次执行时登记自己的格式串，得到一个静态的 id
+ * 2. 调用线程只把 {id, 时间戳, 按类型打标签的原始参数} 写入本线程的
+ *    SPSC 无锁环形缓冲区，不做任何格式化，也不加锁；缓冲区满时丢弃并计数
+ * 3. 后台线程把各线程的记录和新登记的格式串追加到二进制日志文件
+ * 4. 由 BinaryLogging::decode(或 tools/logdecode)离线还原为文本，
+ *    格式与 Logger 的文本日志相同；同一线程内的日志保持顺序
+ *
+ * 参数只支持 printf 的基本类型：整数、浮点数、C 字符串和指针
+ */
+class BinaryLogging : noncopyable {
+public:
+  // 参数的类型标签
+  enum ArgTag : uint8_t { kInt = 1, kUInt, kDouble, kString, kPointer };
+
+  /* 开启二进制日志模式，之后的 LOG_* 都写入 path；ringBytes 为每个线程的
+   * 环形缓冲区大小(向上取整到 2 的幂)。Not thread safe. */
+  static bool start(const std::string &path, size_t ringBytes = 4 << 20);
+  // 写完所有线程缓冲的日志之后关闭文件，恢复文本日志
+  static void stop();
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+  // 因为环形缓冲区满而丢弃的日志条数
+  static uint64_t dropped();
+
+  // 登记一个调用点的格式串，返回其 id。Thread safe.
+  static int registerFormat(int level, const char *file, int line,
+                            const char *fmt);
+
+  // 记录一条日志，由 LOG_* 宏调用
+  template <typename... Args> static void log(int fmtId, Args... args) {
+    // 记录按 8 字节对齐，记录头可以直接按整数读写
+    const size_t size = (kHeaderSize + argsSize(args...) + 7) & ~size_t(7);
+    char *p = reserve(size);
+    if (p == nullptr)
+      return; // 缓冲区满，已计数
+    p = writeHeader(p, size, fmtId);
+    encode(p, args...);
+    commit(size);
+  }
+
+  /* 把二进制日志文件还原为文本，写入 out。
+   * 文件损坏或不是二进制日志时返回 false */
+  static bool decode(const std::string &path, FILE *out);
+
+private:
+  // 记录头：u32 记录长度(按 8 字节对齐) + u32 格式 id + i64 时间戳(微秒)
+  static const size_t kHeaderSize = 16;
+
+  static char *reserve(size_t size);
+  static void commit(size_t size);
+  static char *writeHeader(char *p, size_t size, int fmtId);
+
+  static size_t argsSize() { return 0; }
+  template <typename T, typename... Rest>
+  static size_t argsSize(T first, Rest... rest) {
+    return argSize(first) + argsSize(rest...);
+  }
+
+  static void encode(char *) {}
+  template <typename T, typename... Rest>
+  static void encode(char *p, T first, Rest... rest) {
+    p = encodeArg(p, first);
+    encode(p, rest...);
+  }
+
+  // 整数(包括 bool、char 和枚举)统一编码为 8 字节
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value ||
+                                     std::is_enum<T>::value,
+                                 size_t>::type
+  argSize(T) {
+    return 1 + 8;
+  }
+  template <typename T>
+  static typename std::enable_if<std::is_floating_point<T>::value,
+                                 size_t>::type
+  argSize(T) {
+    return 1 + 8;
+  }
+  static size_t argSize(const char *s) { return 1 + 2 + stringLength(s); }
+  static size_t argSize(const void *) { return 1 + 8; }
+
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value ||
+                                     std::is_enum<T>::value,
+                                 char *>::type
+  encodeArg(char *p, T v) {
+    if (std::is_signed<T>::value) {
+      int64_t x = static_cast<int64_t>(v);
+      return put(put(p, kInt), &x, 8);
+    }
+    uint64_t x = static_cast<uint64_t>(v);
+    return put(put(p, kUInt), &x, 8);
+  }
+  template <typename T>
+  static typename std::enable_if<std::is_floating_point<T>::value,
+                                 char *>::type
+  encodeArg(char *p, T v) {
+    double x = static_cast<double>(v);
+    return put(put(p, kDouble), &x, 8);
+  }
+  static char *encodeArg(char *p, const char *s) {
+    uint16_t len = static_cast<uint16_t>(stringLength(s));
+    p = put(put(p, kString), &len, 2);
+    return put(p, s, len);
+  }
+  static char *encodeArg(char *p, const void *ptr) {
+    uint64_t x = reinterpret_cast<uintptr_t>(ptr);
+    return put(put(p, kPointer), &x, 8);
+  }
+
+  static size_t stringLength(const char *s) {
+    if (s == nullptr)
+      return 0;
+    size_t len = strlen(s);
+    return len > 0xffff ? 0xffff : len;
+  }
+  static char *put(char *p, ArgTag tag) {
+    *p = static_cast<char>(tag);
+    return p + 1;
+  }
+  static char *put(char *p, const void *data, size_t len) {
+    memcpy(p, data, len);
+    return p + len;
+  }
+
+  static std::atomic_bool enabled_;
+};
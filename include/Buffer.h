@@ -1,8 +1,11 @@
 #pragma once
 
+#include "SlabPool.h"
+
 #include <algorithm>
+#include <string.h>
 #include <string>
-#include <vector>
+#include <sys/types.h>
 
 /*
  * A buffer class modeled after org.jboss.netty.buffer.ChannelBuffer
@@ -14,19 +17,54 @@
  * +-------------------+------------------+------------------+
  * |                   |                  |                  |
  * 0      <=      readerIndex   <=   writerIndex    <=     size
- * @endcode */
+ * @endcode
+ *
+ * 内存在第一次写入时才分配。设置了 SlabPool 之后，不超过一个 block 的
+ * 存储从 pool 中取，由所有者在数据读完之后调用 release() 归还(TcpConnection
+ * 在每次 handleRead 结束时)，空闲时不占内存 */
 class Buffer {
 public:
   static const size_t kCheapPrepend = 8;
   static const size_t kInitialSize = 1024;
 
   explicit Buffer(size_t initialSize = kInitialSize)
-      : buffer_(kCheapPrepend + initialSize), readerIndex_(kCheapPrepend),
-        writerIndex_(kCheapPrepend) {}
+      : buffer_(emptyStorage()), size_(kCheapPrepend),
+        readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend),
+        initialSize_(initialSize), pool_(nullptr), pooled_(false) {}
+  ~Buffer() { releaseStorage(); }
+
+  // 拷贝出来的 Buffer 不使用 pool，可以交给其他线程
+  Buffer(const Buffer &rhs) : Buffer(rhs.initialSize_) {
+    append(rhs.peek(), rhs.readableBytes());
+  }
+  Buffer(Buffer &&rhs) noexcept : Buffer(rhs.initialSize_) { swap(rhs); }
+  Buffer &operator=(Buffer rhs) {
+    swap(rhs);
+    return *this;
+  }
+
+  void swap(Buffer &rhs) {
+    std::swap(buffer_, rhs.buffer_);
+    std::swap(size_, rhs.size_);
+    std::swap(readerIndex_, rhs.readerIndex_);
+    std::swap(writerIndex_, rhs.writerIndex_);
+    std::swap(initialSize_, rhs.initialSize_);
+    std::swap(pool_, rhs.pool_);
+    std::swap(pooled_, rhs.pooled_);
+  }
+
+  /* 之后从 pool 中分配存储，pool 属于哪个 loop，Buffer 就只能在该 loop
+   * 线程中使用。应当在 Buffer 还没有数据时调用 */
+  void setPool(SlabPool *pool) {
+    if (readableBytes() == 0)
+      releaseStorage();
+    pool_ = pool;
+  }
+  SlabPool *pool() const { return pool_; }
 
   size_t readableBytes() const { return writerIndex_ - readerIndex_; }
 
-  size_t writableBytes() const { return buffer_.size() - writerIndex_; }
+  size_t writableBytes() const { return size_ - writerIndex_; }
 
   size_t prependableBytes() const { return readerIndex_; }
 
@@ -45,6 +83,10 @@ public:
 
   void retrieveAll() { readerIndex_ = writerIndex_ = kCheapPrepend; }
 
+  /* 丢弃所有数据并释放存储，之前 peek() 得到的指针随之失效；
+   * 不在 retrieveAll 中释放，onMessage 中 retrieve 之后指针仍然有效 */
+  void release() { releaseStorage(); }
+
   // 把 onMessage 函数上报的 Buffer 数据，转成 string 类型返回
   std::string retrieveAllAsString() {
     return retrieveAsString(readableBytes());
@@ -68,6 +110,14 @@ public:
     writerIndex_ += len;
   }
 
+  /* 释放多余的内存，只保留可读数据和 reserve 字节的可写空间
+   * 用于读写高峰过后缩小缓冲区 */
+  void shrink(size_t reserve) {
+    reallocate(kCheapPrepend + readableBytes() + reserve);
+  }
+
+  size_t internalCapacity() const { return size_; }
+
   char *beginWrite() { return begin() + writerIndex_; }
 
   const char *beginWrite() const { return begin() + writerIndex_; }
@@ -76,13 +126,16 @@ public:
   ssize_t writeFd(int fd, int *saveErrno); // 通过 fd 发送数据
 
 private:
-  char *begin() { return &*buffer_.begin(); } // 裸指针
-  const char *begin() const { return &*buffer_.begin(); }
+  char *begin() { return buffer_; } // 裸指针
+  const char *begin() const { return buffer_; }
   void makeSpace(size_t len) { // 整理空间或者扩容
-    if (writableBytes() + prependableBytes() < len + kCheapPrepend)
-      // 加上挂起的数据空间，仍然不够，需要扩容
-      buffer_.resize(writerIndex_ + len);
-    else { // move readable data to the front, make space inside buffer
+    if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
+      // 加上挂起的数据空间，仍然不够，需要扩容，和 std::vector 一样至少翻倍
+      size_t size = kCheapPrepend + readableBytes() + len;
+      if (buffer_ == emptyStorage())
+        size = std::max(size, kCheapPrepend + initialSize_);
+      reallocate(std::max(size, 2 * size_));
+    } else { // move readable data to the front, make space inside buffer
       size_t readalbe = readableBytes();
       std::copy(begin() + readerIndex_, begin() + writerIndex_,
                 begin() + kCheapPrepend);
@@ -91,7 +144,48 @@ private:
     }
   }
 
-  std::vector<char> buffer_;
+  // 换成 size 字节的存储，可读数据挪到 kCheapPrepend 处
+  void reallocate(size_t size) {
+    const size_t readable = readableBytes();
+    const bool pooled = pool_ != nullptr && size <= SlabPool::kBlockSize;
+    char *buf = pooled ? static_cast<char *>(pool_->allocate())
+                       : new char[size]; // 不需要像 std::vector 一样清零
+    if (pooled)
+      size = SlabPool::kBlockSize;
+    memcpy(buf + kCheapPrepend, peek(), readable);
+    releaseStorage();
+    buffer_ = buf;
+    size_ = size;
+    pooled_ = pooled;
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = readerIndex_ + readable;
+  }
+
+  // 释放存储，回到还没有分配内存的状态，调用者保证已经不需要其中的数据
+  void releaseStorage() {
+    if (buffer_ == emptyStorage())
+      return;
+    if (pooled_)
+      pool_->deallocate(buffer_);
+    else
+      delete[] buffer_;
+    buffer_ = emptyStorage();
+    size_ = kCheapPrepend;
+    pooled_ = false;
+    readerIndex_ = writerIndex_ = kCheapPrepend;
+  }
+
+  // 没有分配内存时指向这里，writableBytes() 为 0，不会被写入
+  static char *emptyStorage() {
+    static char empty[kCheapPrepend];
+    return empty;
+  }
+
+  char *buffer_;
+  size_t size_; // 存储的总大小，包括 kCheapPrepend
   size_t readerIndex_;
   size_t writerIndex_;
-};
\ No newline at end of file
+  size_t initialSize_; // 第一次分配时的最小可写空间
+  SlabPool *pool_;
+  bool pooled_; // buffer_ 是否来自 pool_
+};
@@ -15,4 +15,6 @@ using WriteCompleteCallback = std::function<void(const TcpConnectionPtr &)>;
 using MessageCallback =
     std::function<void(const TcpConnectionPtr &, Buffer *, Timestamp)>;
 using HighWaterMarkCallback =
-    std::function<void(const TcpConnectionPtr &, size_t)>;
\ No newline at end of file
+    std::function<void(const TcpConnectionPtr &, size_t)>;
+
+using TimerCallback = std::function<void()>;
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "SlabPool.h"
+#include "noncopyable.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/*
+ * A chain of fixed-size slabs, used as TcpConnection's output buffer.
+ *
+ * @code
+ * head_                                     tail_
+ * +-------------+    +-------------+    +-------------+
+ * | sent | data | -> |    data     | -> | data | free |
+ * +-------------+    +-------------+    +-------------+
+ * @endcode
+ *
+ * 1. append 只往尾部的 slab 写，写满了就挂一个新的 slab，
+ *    不会像 std::vector 一样扩容时拷贝全部数据，也不会挪动未发送的数据
+ * 2. writeFd 用 writev 一次发送多个 slab，发送完的 slab 立即释放，
+ *    积压的连接占用的内存只和待发送的字节数有关
+ * 3. 设置了 SlabPool 时 slab 从 pool 中分配和归还，否则直接 new/delete
+ */
+class ChainBuffer : noncopyable {
+public:
+  // 每个 slab 的数据容量，slab 头和数据正好占一个 SlabPool 的 block
+  static const size_t kSlabSize = SlabPool::kBlockSize - 3 * sizeof(size_t);
+
+  ChainBuffer();
+  ~ChainBuffer();
+
+  /* 之后从 pool 中分配 slab，pool 属于哪个 loop，ChainBuffer 就只能在该
+   * loop 线程中使用。必须在还没有数据时调用 */
+  void setPool(SlabPool *pool) { pool_ = pool; }
+
+  size_t readableBytes() const { return readable_; }
+  size_t slabCount() const { return slabCount_; }
+
+  // 把 [data, data + len] 追加到尾部
+  void append(const void *data, size_t len);
+
+  // 丢弃头部 len 字节已经发送的数据，释放读空的 slab
+  void retrieve(size_t len);
+  void retrieveAll();
+
+  /* 用 writev 发送头部至多 maxBytes 字节的数据(至多 kMaxIovecs 个 slab)，
+   * 不移除已发送的数据 */
+  ssize_t writeFd(int fd, int *saveErrno, size_t maxBytes = SIZE_MAX);
+
+  /* 把可读数据中 [offset, offset + len) 的部分填入 vec，至多 maxIovecs 项，
+   * 返回填入的项数；用于和其他数据合并成一次 writev */
+  int peekIovecs(struct iovec *vec, int maxIovecs, size_t offset,
+                 size_t len) const;
+
+  static const int kMaxIovecs = 64;
+
+private:
+  struct Slab {
+    Slab *next;
+    size_t readIndex;
+    size_t writeIndex;
+    char data[kSlabSize];
+  };
+  static_assert(sizeof(Slab) <= SlabPool::kBlockSize, "Slab too large");
+
+  Slab *allocSlab();
+  void freeSlab(Slab *slab);
+
+  SlabPool *pool_;
+  Slab *head_;
+  Slab *tail_;
+  size_t readable_;
+  size_t slabCount_;
+};
@@ -1,9 +1,9 @@
 #pragma once
 
+#include "SmallFunction.h"
 #include "Timestamp.h"
 #include "noncopyable.h"
 
-#include <functional>
 #include <memory>
 
 class EventLoop;
@@ -15,8 +15,9 @@ class EventLoop;
  */
 class Channel : noncopyable {
 public:
-  using EventCallback = std::function<void()>;
-  using ReadEventCallback = std::function<void(Timestamp)>;
+  // 回调通常是 std::bind(&X::handleXxx, this)，可以存放在内部存储中
+  using EventCallback = SmallFunction<void()>;
+  using ReadEventCallback = SmallFunction<void(Timestamp)>;
 
   Channel(EventLoop *loop, int fd);
   ~Channel();
@@ -60,15 +61,16 @@ public:
     update();
   }
 
+  /* 边缘触发模式，Poller 注册 fd 时附加 EPOLLET
+   * 必须在 channel 注册到 Poller 之前设置 */
+  void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+  bool isEdgeTriggered() const { return edgeTriggered_; }
+
   // 返回 fd 当前的事件状态
   bool isNoneEvent() const { return events_ == kNoneEvent; }
   bool isWriting() const { return events_ & kWriteEvent; }
   bool isReading() const { return events_ & kReadEvent; }
 
-  // for Poller
-  int index() { return index_; }
-  void set_index(int idx) { index_ = idx; }
-
   // one loop per thread
   EventLoop *ownerLoop() { return loop_; }
   void remove();
@@ -102,7 +104,7 @@ private:
    */
   int revents_;
 
-  int index_; // used by Poller
+  bool edgeTriggered_; // 是否以 EPOLLET 注册
 
   /* Tie this channel to the owner object managed by shared_ptr,
    * prevent the owner object being destroyed in handleEvent.
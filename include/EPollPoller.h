@@ -8,7 +8,14 @@
 
 class Channel;
 
-// IO Multiplexing with epoll(4).
+/*
+ * IO Multiplexing with epoll(4).
+ *
+ * updateChannel 只记录 channel 关注的事件并把 fd 标记为 dirty，
+ * 在下一次 poll() 之前统一与内核中注册的事件比较，只对真正变化的 fd 调用
+ * epoll_ctl；同一轮中先 enableWriting 再 disableWriting 会相互抵消。
+ * removeChannel 仍然立即 EPOLL_CTL_DEL，因为 fd 随后就会被关闭
+ */
 class EPollPoller : public Poller {
 public:
   EPollPoller(EventLoop *loop);
@@ -18,6 +25,7 @@ public:
   Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
   void updateChannel(Channel *channel) override;
   void removeChannel(Channel *channel) override;
+  bool setBusyPoll(int usecs, int budget) override; // EPIOCSPARAMS
 
 private:
   static const int kInitEventListSize = 16;
@@ -25,11 +33,15 @@ private:
   // 填写活跃的连接
   void fillActiveChannels(int numEvents, ChannelList *activeChannels) const;
 
-  // 更新 channel 所关注的事件
-  void update(int operation, Channel *channel);
+  // 把 dirty 的 channel 关注的事件同步到内核
+  void syncDirtyChannels();
+
+  // epoll_ctl() 操作，events 为要注册的事件
+  void update(int operation, Channel *channel, uint32_t events);
 
   using EventList = std::vector<epoll_event>;
 
   int epollfd_;
   EventList events_;
+  std::vector<int> dirtyFds_; // 本轮关注的事件发生变化的 fd
 };
\ No newline at end of file
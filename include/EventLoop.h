@@ -1,17 +1,23 @@
 #pragma once
 
 #include <atomic>
-#include <functional>
 #include <memory>
-#include <mutex>
 #include <vector>
 
+#include "Callbacks.h"
 #include "CurrentThread.h"
+#include "EventLoopMetrics.h"
+#include "MpscQueue.h"
+#include "SmallFunction.h"
+#include "TimerId.h"
 #include "Timestamp.h"
 #include "noncopyable.h"
 
 class Channel;
 class Poller;
+class SlabPool;
+class TimerQueue;
+class TimingWheel;
 
 /*
  * Reactor, at most one per thread.
@@ -26,7 +32,9 @@ class Poller;
  */
 class EventLoop : noncopyable {
 public:
-  using Functor = std::function<void()>; // 定义回调函数类型别名
+  /* 定义回调函数类型别名，只能移动；
+   * std::bind(&TcpConnection::xxx, conn) 这类回调入队时不分配内存 */
+  using Functor = SmallFunction<void()>;
 
   EventLoop();
   ~EventLoop(); // force out-line dtor, for std::unique_ptr members.
@@ -42,9 +50,24 @@ public:
    * better to call through shared_ptr<EventLoop> for 100% safety. */
   void quit();
 
-  /* Time when poll returns, usually means data arrival. */
+  /* Time when poll returns, usually means data arrival.
+   * 也是本线程的 Timestamp::cachedNow()，每轮 poll 刷新一次 */
   Timestamp pollReturnTime() const { return pollReturnTime_; }
 
+  // busy polling，用 CPU 换取更低的唤醒延迟
+
+  /* 阻塞等待之前，先以 0 超时连续轮询至多 spinPolls 次，任何一次轮询到事件
+   * 都重新开始计数；0 表示关闭(默认)。
+   * Must be called in the loop thread, eg. in ThreadInitCallback. */
+  void setSpinPolls(int spinPolls) { spinPolls_ = spinPolls; }
+  /* 设置 Poller 的内核 busy poll 参数(epoll 的 EPIOCSPARAMS)，
+   * 内核或 Poller 不支持时返回 false. Must be called in the loop thread. */
+  bool setKernelBusyPoll(int usecs, int budget);
+
+  /* Runtime metrics of this loop, including counters of busy polling.
+   * Safe to call from other threads. */
+  EventLoopMetrics::Snapshot metrics() const { return metrics_.snapshot(); }
+
   /* Runs callback immediately in the loop thread.
    * It wakes up the loop, and run the cb.
    * If in the same loop thread, cb is run within the function.
@@ -53,8 +76,37 @@ public:
   /* Queues callback in the loop thread.
    * Runs after finish pooling.
    * Safe to call from other threads.
-   * 把 cb 放入 pendingFunctors_ 中，等待 loop 线程处理 */
+   * 把 cb 放入无锁队列 pendingFunctors_ 中，等待 loop 线程处理 */
   void queueInLoop(Functor cb);
+  /* Queues callback to run once this iteration's channel dispatch finishes,
+   * before pending functors and the next poll; callbacks queued by pending
+   * functors run right after them. Must be called in the loop thread.
+   * 用于把一轮中多次 send 的数据合并到一次 write/writev 中发送(auto-cork) */
+  void queueFlush(Functor cb);
+
+  // timers，回调都在 loop 线程中执行
+
+  /* Runs callback at 'time'.
+   * Safe to call from other threads. */
+  TimerId runAt(Timestamp time, TimerCallback cb);
+  /* Runs callback after @c delay seconds.
+   * Safe to call from other threads. */
+  TimerId runAfter(double delay, TimerCallback cb);
+  /* Runs callback every @c interval seconds.
+   * Safe to call from other threads. */
+  TimerId runEvery(double interval, TimerCallback cb);
+  /* Cancels the timer.
+   * Safe to call from other threads. */
+  void cancel(TimerId timerId);
+
+  /* Hashed timing wheel of this loop, for idle/read timeouts of connections.
+   * Created on first use, must be called in the loop thread. */
+  TimingWheel *timingWheel();
+
+  /* Slab pool of this loop, backing the buffers of its connections.
+   * Created on first use, must be called in the loop thread.
+   * 创建时注册一个定时器，定期释放一直空闲的 block */
+  SlabPool *slabPool();
 
   /* internal usage */
   void wakeup(); // mainLoop 唤醒 subLoop，即唤醒 loop 所在线程
@@ -68,14 +120,21 @@ public:
 private:
   void handleRead();        // waked up 之后的处理函数(回调)
   void doPendingFunctors(); // 执行所有待处理的回调函数
+  void doFlushes();         // 执行 queueFlush 提交的回调
 
   using ChannelList = std::vector<Channel *>; // 定义 channel 列表的类型别名
 
   std::atomic_bool looping_;
-  std::atomic_bool quit_;
+  alignas(64) std::atomic_bool quit_; // 其他线程会写，独占一个 cache line
   const pid_t threadId_;     // 记录当前 loop 所在线程的 ID
   Timestamp pollReturnTime_; // Poller 返回发生事件的 channels 的时间点
   std::unique_ptr<Poller> poller_; // Poller 的智能指针
+  std::unique_ptr<TimerQueue> timerQueue_; // 定时器队列，基于 timerfd
+  std::unique_ptr<TimingWheel> timingWheel_; // 时间轮，按需创建
+  std::unique_ptr<SlabPool> slabPool_;       // 连接缓冲区的内存池，按需创建
+
+  int spinPolls_; // 阻塞等待之前 0 超时轮询的次数
+  EventLoopMetrics metrics_; // 只由 loop 线程写，其他线程可以读
 
   /* 当 mainLoop 获取一个新用户的 channel，通过轮询算法选择一个 subloop，
    * 通过该成员唤醒 subloop 处理 channel
@@ -91,8 +150,17 @@ private:
   ChannelList activeChannels_; // 活跃的 channel 列表
   // Channel *currentActiveChannel_; // 当前正在处理的 channel
 
-  std::atomic_bool
-      callingPendingFunctors_; // 标识当前 loop 是否有需要执行的回调
-  std::vector<Functor> pendingFunctors_; // 存储 loop 需要执行的所有回调
-  std::mutex mutex_; // 互斥锁，用来保证 pendingFunctors_ 的线程安全
+  // 标识当前 loop 是否正在执行回调，生产者线程会读，独占一个 cache line
+  alignas(64) std::atomic_bool callingPendingFunctors_;
+  /* 是否已经写过 wakeupFd_ 且 loop 尚未开始处理回调，
+   * 同一轮中只有第一个生产者需要写 eventfd */
+  alignas(64) std::atomic_bool wakeupPending_;
+  MpscQueue<Functor> pendingFunctors_; // 存储其他线程提交的回调
+  /* loop 线程自己提交的回调，只有 loop 线程访问，不需要同步；
+   * 与 functors_ 交换使用，容量保留下来，稳定后入队不再分配内存 */
+  std::vector<Functor> localFunctors_;
+  std::vector<Functor> functors_; // scratch variable，本轮需要执行的回调
+  // queueFlush 提交的回调，只有 loop 线程访问；与 flushing_ 交换使用
+  std::vector<Functor> flushFunctors_;
+  std::vector<Functor> flushing_;
 };
\ No newline at end of file
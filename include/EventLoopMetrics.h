@@ -0,0 +1,123 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+/*
+ * Runtime metrics of one EventLoop.
+ *
+ * 1. 只有 loop 线程写(单写者)，计数器用 relaxed 的 load + store 累加，
+ *    不需要 lock 前缀的原子指令，也不加锁
+ * 2. 任意线程都可以通过 snapshot() 读取，各个计数器之间不保证是同一时刻的值
+ * 3. 所有数值都是累计值，需要速率时由调用者对两次快照求差
+ */
+
+// 按 2 的幂分桶的直方图，第 i 个桶统计 [2^(i-1), 2^i) 的值，第 0 个桶统计 0
+class Histogram : noncopyable {
+public:
+  static const int kBuckets = 32;
+
+  struct Snapshot {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[kBuckets];
+
+    double mean() const {
+      return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+    }
+    // 第 p(0 ~ 1) 分位数所在桶的上界
+    uint64_t percentile(double p) const;
+  };
+
+  Histogram();
+
+  // Must be called in the loop thread.
+  void record(uint64_t value) {
+    int bucket = 0;
+    if (value != 0) {
+      bucket = 64 - __builtin_clzll(value);
+      if (bucket >= kBuckets)
+        bucket = kBuckets - 1;
+    }
+    add(&buckets_[bucket], 1);
+    add(&count_, 1);
+    add(&sum_, value);
+    if (value > max_.load(std::memory_order_relaxed))
+      max_.store(value, std::memory_order_relaxed);
+  }
+
+  // Safe to call from other threads.
+  Snapshot snapshot() const;
+
+  // 单写者的累加，不需要 fetch_add
+  static void add(std::atomic<uint64_t> *counter, uint64_t n) {
+    counter->store(counter->load(std::memory_order_relaxed) + n,
+                   std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<uint64_t> buckets_[kBuckets];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+};
+
+class EventLoopMetrics : noncopyable {
+public:
+  struct Snapshot {
+    uint64_t iterations;     // loop 的迭代次数
+    uint64_t wakeupsSent;    // 写 eventfd 唤醒 loop 的次数
+    uint64_t wakeupsHandled; // loop 读 eventfd 的次数
+    uint64_t spinPolls;      // busy polling 时 0 超时的轮询次数
+    uint64_t spinHits;       // 其中轮询到事件的次数
+    uint64_t blockingPolls;  // 阻塞等待的次数
+
+    Histogram::Snapshot pollUs;        // 每次 poll 的耗时，单位为微秒
+    Histogram::Snapshot eventsPerPoll; // 每次 poll 返回的活跃 channel 数
+    Histogram::Snapshot dispatchUs;    // 每轮 handleEvent 回调的总耗时
+    Histogram::Snapshot functorDepth;  // 每轮执行的 pending functor 数量
+    Histogram::Snapshot functorUs;     // 每轮 pending functor 的总耗时
+
+    // 单行的文本形式，便于打日志
+    std::string toString() const;
+  };
+
+  EventLoopMetrics();
+
+  // 单调时钟的当前时间，单位为微秒
+  static int64_t nowMicros();
+
+  // Safe to call from other threads.
+  Snapshot snapshot() const;
+
+  // 以下都由 loop 线程调用，wakeupsSent 除外
+  void addIteration() { Histogram::add(&iterations_, 1); }
+  void addWakeupSent() { // 由生产者线程调用，可能并发
+    wakeupsSent_.fetch_add(1, std::memory_order_relaxed);
+  }
+  void addWakeupHandled() { Histogram::add(&wakeupsHandled_, 1); }
+  void addSpinPoll(bool hit) {
+    Histogram::add(&spinPolls_, 1);
+    if (hit)
+      Histogram::add(&spinHits_, 1);
+  }
+  void addBlockingPoll() { Histogram::add(&blockingPolls_, 1); }
+
+  Histogram pollUs;
+  Histogram eventsPerPoll;
+  Histogram dispatchUs;
+  Histogram functorDepth;
+  Histogram functorUs;
+
+private:
+  std::atomic<uint64_t> iterations_;
+  std::atomic<uint64_t> wakeupsSent_;
+  std::atomic<uint64_t> wakeupsHandled_;
+  std::atomic<uint64_t> spinPolls_;
+  std::atomic<uint64_t> spinHits_;
+  std::atomic<uint64_t> blockingPolls_;
+};
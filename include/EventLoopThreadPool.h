@@ -1,4 +1,5 @@
 #pragma once
+#include "EventLoopMetrics.h"
 #include "noncopyable.h"
 
 #include <functional>
@@ -27,6 +28,11 @@ public:
 
   std::vector<EventLoop *> getAllLoops();
 
+  /* valid after calling start()
+   * 所有 loop 的运行时指标快照，顺序与 getAllLoops() 相同
+   * Safe to call from other threads. */
+  std::vector<EventLoopMetrics::Snapshot> metrics();
+
   bool started() const { return started_; }
   const std::string name() const { return name_; }
 
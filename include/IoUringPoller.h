@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Poller.h"
+#include "Timestamp.h"
+
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <vector>
+
+class Channel;
+
+/*
+ * IO Multiplexing with io_uring(7).
+ *
+ * 用 one-shot 的 IORING_OP_POLL_ADD 模拟水平触发的 epoll：
+ * 1. 每个 channel 同一时刻至多只有一个在途的 poll 请求
+ * 2. updateChannel/removeChannel 以及事件触发后的重新注册，都只是写入 SQ，
+ *    在下一次 poll() 时和等待完成事件合并为一次 io_uring_enter 系统调用
+ * 3. 数据的读写仍然由 TcpConnection 通过 read/write 完成
+ */
+class IoUringPoller : public Poller {
+public:
+  IoUringPoller(EventLoop *loop);
+  ~IoUringPoller() override;
+
+  // 内核不支持或者 io_uring 被禁用时返回 false，由调用者回退到 epoll
+  bool valid() const { return ringFd_ >= 0; }
+
+  // 重写基类 Poller 的抽象方法
+  Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+  void updateChannel(Channel *channel) override;
+  void removeChannel(Channel *channel) override;
+
+private:
+  static const unsigned kRingEntries = 1024;
+
+  // 每个 fd 在 io_uring 中的注册状态
+  struct PollState {
+    uint32_t gen; // 在途 poll 请求的序号，用于识别过期的完成事件
+    int events;   // 在途 poll 请求关注的事件
+    bool armed;   // 是否有在途的 poll 请求
+    bool dirty;   // 是否在 dirtyFds_ 中，等待下一次 poll() 重新注册
+  };
+
+  bool setupRing();
+  void teardownRing();
+
+  io_uring_sqe *getSqe(); // 获取一个空闲的 SQE，SQ 满时先提交
+  // 返回 false 表示 io_uring_enter 出错(超时和被信号中断除外)
+  bool submit(unsigned minComplete, int timeoutMs, bool wait);
+
+  // 返回 fd 对应的 PollState，与 channels_ 一样以 fd 为下标
+  PollState &stateOf(int fd) {
+    if (static_cast<size_t>(fd) >= states_.size())
+      states_.resize(std::max(static_cast<size_t>(fd) + 1, channels_.size()),
+                     PollState{0, 0, false, false});
+    return states_[fd];
+  }
+
+  void markDirty(int fd, PollState *state);
+  void armPoll(int fd, Channel *channel, PollState *state);
+  void cancelPoll(PollState *state, int fd);
+
+  // 收割 CQ 中的完成事件，填写活跃的连接
+  int reapCompletions(ChannelList *activeChannels);
+
+  int ringFd_;
+
+  // SQ ring
+  void *sqRing_;
+  size_t sqRingSize_;
+  unsigned *sqHead_;
+  unsigned *sqTail_;
+  unsigned *sqMask_;
+  unsigned *sqArray_;
+  unsigned sqEntries_;
+  io_uring_sqe *sqes_;
+  size_t sqesSize_;
+  unsigned toSubmit_; // 已写入 SQ 但尚未提交的 SQE 数量
+
+  // CQ ring，内核支持 IORING_FEAT_SINGLE_MMAP 时和 SQ ring 共用一块映射
+  void *cqRing_;
+  size_t cqRingSize_;
+  unsigned *cqHead_;
+  unsigned *cqTail_;
+  unsigned *cqMask_;
+  io_uring_cqe *cqes_;
+
+  std::vector<PollState> states_; // {sockfd => PollState}
+  std::vector<int> dirtyFds_; // 本轮需要重新注册 poll 请求的 fd
+  uint32_t nextGen_;
+};
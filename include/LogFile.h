@@ -0,0 +1,45 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stdio.h>
+#include <string>
+#include <sys/types.h>
+#include <time.h>
+
+/*
+ * Rolling log file, used by the background thread of AsyncLogging.
+ * Not thread safe.
+ *
+ * 1. 写入的字节数超过 rollSize，或者跨过一个滚动周期(默认一天)时，
+ *    滚动到新文件 basename.YYYYmmdd-HHMMSS.hostname.pid.log
+ * 2. 使用 fwrite_unlocked 和 64 KiB 的用户态缓冲区，
+ *    每隔 flushInterval 秒至少 fflush 一次
+ */
+class LogFile : noncopyable {
+public:
+  LogFile(const std::string &basename, off_t rollSize, int flushInterval = 3,
+          int rollInterval = 60 * 60 * 24, int checkEveryN = 1024);
+  ~LogFile();
+
+  void append(const char *logline, size_t len);
+  void flush();
+  bool rollFile(); // 同一秒内重复滚动时返回 false，继续写当前文件
+
+private:
+  static std::string getLogFileName(const std::string &basename, time_t now);
+
+  const std::string basename_;
+  const off_t rollSize_;     // 单个文件的字节数上限
+  const int flushInterval_;  // fflush 的间隔，单位为秒
+  const int rollInterval_;   // 按时间滚动的周期，单位为秒
+  const int checkEveryN_;    // 每写 N 次检查一次时间，减少 time() 调用
+
+  int count_;             // 距离上一次检查时间写入的次数
+  time_t startOfPeriod_;  // 当前文件所在滚动周期的起始时间
+  time_t lastRoll_;       // 上一次滚动的时间
+  time_t lastFlush_;      // 上一次 fflush 的时间
+  off_t writtenBytes_;    // 写入当前文件的字节数
+  FILE *fp_;
+  char buffer_[64 * 1024]; // fp_ 的缓冲区
+};
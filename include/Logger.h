@@ -1,72 +1,110 @@
 #pragma once
+#include "BinaryLogging.h"
 #include "noncopyable.h"
+#include <atomic>
+#include <functional>
+#include <stdlib.h>
 #include <string>
 
+// 定义日志的级别，从低到高
+enum LogLevel {
+  DEBUG, // 调试信息
+  INFO,  // 普通信息
+  ERROR, // 错误信息
+  FATAL, // 严重错误信息（导致程序退出）
+};
+
+/* 编译期的最低日志级别，低于它的 LOG_* 语句在编译期就被消除
+ * 默认为 INFO，定义了 MUDEBUG 时为 DEBUG，也可以用 -DMUDUO_MIN_LOG_LEVEL=2
+ * 直接指定(0 ~ 3 分别对应 DEBUG ~ FATAL) */
+#ifndef MUDUO_MIN_LOG_LEVEL
+#ifdef MUDEBUG
+#define MUDUO_MIN_LOG_LEVEL 0
+#else
+#define MUDUO_MIN_LOG_LEVEL 1
+#endif
+#endif
+
+/* 1. 先比较编译期的最低级别，再读一次运行时的阈值，都通过才格式化，
+ *    关闭的日志语句在热路径上只有一次可预测的分支
+ * 2. 级别作为参数传给 Logger::logf，不修改任何共享状态
+ * 3. 开启 BinaryLogging 时不格式化，只记录调用点的格式串 id 和原始参数
+ * 使用方法: MUDUO_LOG(INFO, "%s %d", arg1, arg2) */
+#define MUDUO_LOG(level, logmsgFormat, ...)                                    \
+  do {                                                                         \
+    if ((level) >= MUDUO_MIN_LOG_LEVEL && Logger::isEnabled(level)) {          \
+      if (BinaryLogging::enabled()) {                                          \
+        static const int muduoFmtId = BinaryLogging::registerFormat(           \
+            level, __FILE__, __LINE__, logmsgFormat);                          \
+        BinaryLogging::log(muduoFmtId, ##__VA_ARGS__);                         \
+      } else                                                                   \
+        Logger::logf(level, logmsgFormat, ##__VA_ARGS__);                      \
+    }                                                                          \
+  } while (0)
+
+// 用于记录调试级别日志的宏，默认在编译期关闭，定义 MUDEBUG 时开启
+// 使用方法: LOG_DEBUG("%s %d", arg1, arg2)
+#define LOG_DEBUG(logmsgFormat, ...)                                           \
+  MUDUO_LOG(DEBUG, logmsgFormat, ##__VA_ARGS__)
+
 // 用于记录信息级别日志的宏
 // 使用方法: LOG_INFO("%s %d", arg1, arg2)
 // 可变参，logmsgFormat 为格式化字符串，##__VA_ARGS__ 为可变参数
 #define LOG_INFO(logmsgFormat, ...)                                            \
-  do {                                                                         \
-    Logger &logger = Logger::instance();                                       \
-    logger.setLogLevel(INFO);                                                  \
-    char buf[1024] = {0};                                                      \
-    snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__);                          \
-    logger.log(buf);                                                           \
-  } while (0)
+  MUDUO_LOG(INFO, logmsgFormat, ##__VA_ARGS__)
 
 // 用于记录错误级别日志的宏
 // 使用方法: LOG_ERROR("%s %d", arg1, arg2)
 #define LOG_ERROR(logmsgFormat, ...)                                           \
-  do {                                                                         \
-    Logger &logger = Logger::instance();                                       \
-    logger.setLogLevel(ERROR);                                                 \
-    char buf[1024] = {0};                                                      \
-    snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__);                          \
-    logger.log(buf);                                                           \
-  } while (0)
+  MUDUO_LOG(ERROR, logmsgFormat, ##__VA_ARGS__)
 
-// 用于记录严重错误级别日志并退出程序的宏
+// 用于记录严重错误级别日志并退出程序的宏，不受日志级别的限制
 // 使用方法: LOG_FATAL("%s %d", arg1, arg2)
 #define LOG_FATAL(logmsgFormat, ...)                                           \
   do {                                                                         \
-    Logger &logger = Logger::instance();                                       \
-    logger.setLogLevel(FATAL);                                                 \
-    char buf[1024] = {0};                                                      \
-    snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__);                          \
-    logger.log(buf);                                                           \
+    Logger::logf(FATAL, logmsgFormat, ##__VA_ARGS__);                          \
+    Logger::instance().flush();                                                \
     exit(-1);                                                                  \
   } while (0)
 
-// 用于记录调试级别日志的宏，仅在定义了 MUDEBUG 时有效
-// 使用方法: LOG_DEBUG("%s %d", arg1, arg2)
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgFormat, ...)                                           \
-  do {                                                                         \
-    Logger &logger = Logger::instance();                                       \
-    logger.setLogLevel(DEBUG);                                                 \
-    char buf[1024] = {0};                                                      \
-    snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__);                          \
-    logger.log(buf);                                                           \
-  } while (0)
-#else
-#define LOG_DEBUG(logmsgFormat, ...)
-#endif
-
-// 定义日志的级别
-enum LogLevel {
-  INFO,  // 普通信息
-  ERROR, // 错误信息
-  FATAL, // 严重错误信息（导致程序退出）
-  DEBUG, // 调试信息
-};
-
 // 日志类
 class Logger : noncopyable {
 public:
+  // 日志的输出目的地，默认为带缓冲的 stdout，可以换成 AsyncLogging::append
+  using OutputFunc = std::function<void(const char *msg, int len)>;
+  using FlushFunc = std::function<void()>;
+
   static Logger &instance(); // 获取 Logger 的唯一实例对象（单例模式）
-  void setLogLevel(int level); // 设置日志级别
-  void log(std::string msg);   // 写日志
+
+  /* 运行时的日志级别阈值，低于它的日志不会被格式化
+   * 默认为 DEBUG，即只受编译期的 MUDUO_MIN_LOG_LEVEL 限制
+   * Thread safe. */
+  static void setLogLevel(LogLevel level) {
+    logLevel_.store(level, std::memory_order_relaxed);
+  }
+  static LogLevel logLevel() {
+    return static_cast<LogLevel>(logLevel_.load(std::memory_order_relaxed));
+  }
+  static bool isEnabled(LogLevel level) {
+    return level >= logLevel_.load(std::memory_order_relaxed);
+  }
+
+  // 格式化并写一条日志，由 LOG_* 宏在级别检查通过之后调用
+  static void logf(LogLevel level, const char *fmt, ...)
+      __attribute__((format(printf, 2, 3)));
+
+  void flush(); // 刷新输出，LOG_FATAL 退出之前调用
+
+  /* Not thread safe, should be called before any other threads start
+   * logging. 设置输出函数和刷新函数 */
+  void setOutput(OutputFunc out) { output_ = std::move(out); }
+  void setFlush(FlushFunc flush) { flush_ = std::move(flush); }
 
 private:
-  int logLevel_; // 当前的日志级别
+  Logger();
+
+  static std::atomic_int logLevel_; // 运行时的日志级别阈值
+
+  OutputFunc output_;
+  FlushFunc flush_;
 };
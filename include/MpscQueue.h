@@ -0,0 +1,64 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <utility>
+
+/*
+ * Lock-free multi-producer single-consumer queue.
+ * (Dmitry Vyukov's non-intrusive MPSC node-based queue)
+ *
+ * 1. push 可以在任意线程并发调用，只有一次 atomic exchange，不会阻塞
+ * 2. pop 只能由唯一的消费者线程(loop 线程)调用
+ * 3. 生产者刚完成 exchange、还没有链接 next 时，pop 会暂时返回 false，
+ *    调用者需要依赖其他机制(如 eventfd 唤醒)保证之后再次 pop
+ * 4. head_ 由生产者修改，tail_ 由消费者修改，分别放在独立的 cache line 上
+ */
+template <typename T> class MpscQueue : noncopyable {
+public:
+  MpscQueue() : head_(new Node), tail_(head_.load(std::memory_order_relaxed)) {}
+
+  ~MpscQueue() {
+    T value;
+    while (pop(&value))
+      ;
+    delete tail_; // stub
+  }
+
+  // Must be thread safe.
+  void push(T value) {
+    Node *node = new Node(std::move(value));
+    Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // 只能在消费者线程调用，队列为空时返回 false
+  bool pop(T *value) {
+    Node *tail = tail_;
+    Node *next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr)
+      return false;
+    *value = std::move(next->value);
+    tail_ = next; // next 成为新的 stub
+    delete tail;
+    return true;
+  }
+
+  // 只能在消费者线程调用
+  bool empty() const {
+    return tail_->next.load(std::memory_order_acquire) == nullptr;
+  }
+
+private:
+  struct Node {
+    Node() : next(nullptr) {}
+    explicit Node(T &&v) : next(nullptr), value(std::move(v)) {}
+
+    std::atomic<Node *> next;
+    T value;
+  };
+
+  alignas(64) std::atomic<Node *> head_; // 生产者端，最后一个节点
+  alignas(64) Node *tail_;               // 消费者端，stub 节点
+};
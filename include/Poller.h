@@ -3,7 +3,8 @@
 #include "Timestamp.h"
 #include "noncopyable.h"
 
-#include <unordered_map>
+#include <algorithm>
+#include <stdint.h>
 #include <vector>
 
 class Channel;
@@ -27,6 +28,12 @@ public:
   // Remove the channel, when it destructs.
   virtual void removeChannel(Channel *channel) = 0;
 
+  /* 设置内核的 busy poll 参数，等待事件时由内核在 NAPI 上忙轮询 usecs 微秒，
+   * 每次至多处理 budget 个包；不支持时返回 false */
+  virtual bool setBusyPoll(int /*usecs*/, int /*budget*/) {
+    return false;
+  }
+
   // 判断参数 channel 是否在当前 Poller 中
   bool hasChannel(Channel *channel) const;
 
@@ -34,8 +41,28 @@ public:
   static Poller *newDefaultPoller(EventLoop *loop);
 
 protected:
-  using ChannelMap = std::unordered_map<int, Channel *>;
-  ChannelMap channels_; // {sockfd, Channel *}
+  /* fd 是从小到大分配的稠密整数，直接以 fd 为下标索引，
+   * 避免哈希表的哈希计算和节点分配；channel 指针和它在 Poller 中的状态
+   * 放在同一个 slot 里，一次访存即可取得 */
+  struct ChannelSlot {
+    Channel *channel; // nullptr 表示该 fd 没有注册到当前 Poller
+    int index;        // channel 在 Poller 中的状态，-1 即 kNew
+    uint32_t events;  // 内核中实际注册的事件，0 表示未注册，由子类维护
+    bool dirty;       // 关注的事件有变化，等待下一次 poll() 之前同步到内核
+  };
+  using ChannelTable = std::vector<ChannelSlot>;
+
+  // 返回 fd 对应的 slot，fd 超出当前表长时按倍数扩容
+  ChannelSlot &slotOf(int fd) {
+    if (static_cast<size_t>(fd) >= channels_.size())
+      channels_.resize(std::max(static_cast<size_t>(fd) + 1,
+                                channels_.size() * 2),
+                       ChannelSlot{nullptr, -1, 0, false});
+    return channels_[fd];
+  }
+
+  ChannelTable channels_; // {sockfd => Channel *, index}
+  size_t numChannels_;    // 当前注册的 channel 数量
 
 private:
   EventLoop *ownerLoop_; // 定义 Poller 所属的事件循环
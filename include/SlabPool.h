@@ -0,0 +1,45 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stddef.h>
+
+/*
+ * Per-EventLoop free list of fixed-size memory blocks, backing the input
+ * Buffer and output ChainBuffer of connections.
+ *
+ * 1. 连接的缓冲区只在有数据时才从所属 loop 的 pool 中取 block，
+ *    数据读完或发送完立即归还，空闲连接不占用缓冲区内存
+ * 2. 归还的 block 挂在空闲链表上复用，超过 maxFreeBlocks 的直接释放
+ * 3. trim 由 EventLoop 定期调用：释放上一个周期内一直没有被用到的空闲 block，
+ *    突发流量过后 pool 会逐渐缩回实际需要的大小
+ *
+ * Not thread safe, all operations must be done in the loop thread.
+ */
+class SlabPool : noncopyable {
+public:
+  static const size_t kBlockSize = 16 * 1024;
+
+  explicit SlabPool(size_t maxFreeBlocks = 1024);
+  ~SlabPool();
+
+  void *allocate(); // 返回 kBlockSize 字节的 block，内容未初始化
+  void deallocate(void *block);
+
+  // 释放自上次 trim 以来一直空闲的 block
+  void trim();
+
+  size_t freeBlocks() const { return freeCount_; }
+  size_t blocksInUse() const { return inUse_; }
+
+private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  FreeBlock *freeList_;
+  size_t freeCount_;
+  size_t lowWater_; // 上次 trim 之后空闲链表的最小长度
+  const size_t maxFreeBlocks_;
+  size_t inUse_;
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Move-only callable wrapper with inline storage, a replacement of
+ * std::function for callbacks on the hot path.
+ *
+ * 1. 不超过 Capacity 字节、且移动构造不抛异常的可调用对象直接存放在内部，
+ *    构造、移动、析构都不分配内存；默认 48 字节，足够容纳
+ *    std::bind(&TcpConnection::xxx, shared_ptr, ...) 这样
+ *    成员函数指针 + shared_ptr + 少量参数的组合
+ * 2. 更大的对象退化为堆上分配，行为与 std::function 相同
+ * 3. 只能移动，不能拷贝，避免无意中复制捕获的 shared_ptr 等状态
+ */
+template <typename Signature, size_t Capacity = 48> class SmallFunction;
+
+template <typename R, typename... Args, size_t Capacity>
+class SmallFunction<R(Args...), Capacity> {
+public:
+  SmallFunction() noexcept : ops_(nullptr) {}
+  SmallFunction(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+  template <typename F,
+            typename = typename std::enable_if<!std::is_same<
+                typename std::decay<F>::type, SmallFunction>::value>::type>
+  SmallFunction(F &&f) : ops_(nullptr) {
+    assign(std::forward<F>(f));
+  }
+
+  SmallFunction(SmallFunction &&other) noexcept : ops_(other.ops_) {
+    if (ops_ != nullptr) {
+      ops_->move(&storage_, &other.storage_);
+      other.ops_ = nullptr;
+    }
+  }
+
+  SmallFunction &operator=(SmallFunction &&other) noexcept {
+    if (this != &other) {
+      reset();
+      if (other.ops_ != nullptr) {
+        other.ops_->move(&storage_, &other.storage_);
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  SmallFunction &operator=(std::nullptr_t) noexcept {
+    reset();
+    return *this;
+  }
+
+  SmallFunction(const SmallFunction &) = delete;
+  SmallFunction &operator=(const SmallFunction &) = delete;
+
+  ~SmallFunction() { reset(); }
+
+  R operator()(Args... args) const {
+    if (ops_ == nullptr)
+      throw std::bad_function_call();
+    return ops_->invoke(&storage_, std::forward<Args>(args)...);
+  }
+
+  explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+private:
+  using Storage =
+      typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type;
+
+  // 按存储方式分派的操作表，每种可调用类型一份
+  struct Ops {
+    R (*invoke)(void *self, Args &&...args);
+    void (*move)(void *dst, void *src); // 移动到 dst 并析构 src
+    void (*destroy)(void *self);
+  };
+
+  template <typename F> struct InlineOps {
+    static F *get(void *self) { return static_cast<F *>(self); }
+    static R invoke(void *self, Args &&...args) {
+      // R 为 void 时丢弃返回值，和 std::function<void()> 一样接受有返回值的调用
+      return static_cast<R>((*get(self))(std::forward<Args>(args)...));
+    }
+    static void move(void *dst, void *src) {
+      ::new (dst) F(std::move(*get(src)));
+      get(src)->~F();
+    }
+    static void destroy(void *self) { get(self)->~F(); }
+    static const Ops *ops() {
+      static const Ops kOps = {&invoke, &move, &destroy};
+      return &kOps;
+    }
+  };
+
+  template <typename F> struct HeapOps {
+    static F *&get(void *self) { return *static_cast<F **>(self); }
+    static R invoke(void *self, Args &&...args) {
+      // R 为 void 时丢弃返回值，和 std::function<void()> 一样接受有返回值的调用
+      return static_cast<R>((*get(self))(std::forward<Args>(args)...));
+    }
+    static void move(void *dst, void *src) { ::new (dst) F *(get(src)); }
+    static void destroy(void *self) { delete get(self); }
+    static const Ops *ops() {
+      static const Ops kOps = {&invoke, &move, &destroy};
+      return &kOps;
+    }
+  };
+
+  template <typename F> struct FitsInline {
+    static const bool value = sizeof(F) <= sizeof(Storage) &&
+                              alignof(F) <= alignof(Storage) &&
+                              std::is_nothrow_move_constructible<F>::value;
+  };
+
+  // 空的 std::function 和空指针构造出的 SmallFunction 也是空的
+  template <typename F> static bool isNull(const F &) { return false; }
+  template <typename T> static bool isNull(T *p) { return p == nullptr; }
+  template <typename S> static bool isNull(const std::function<S> &f) {
+    return !f;
+  }
+
+  template <typename F> void assign(F &&f) {
+    using Fn = typename std::decay<F>::type;
+    if (isNull(f))
+      return;
+    construct<Fn>(std::forward<F>(f),
+                  std::integral_constant<bool, FitsInline<Fn>::value>());
+  }
+
+  template <typename Fn, typename F>
+  void construct(F &&f, std::true_type) {
+    ::new (&storage_) Fn(std::forward<F>(f));
+    ops_ = InlineOps<Fn>::ops();
+  }
+
+  template <typename Fn, typename F>
+  void construct(F &&f, std::false_type) {
+    ::new (&storage_) Fn *(new Fn(std::forward<F>(f)));
+    ops_ = HeapOps<Fn>::ops();
+  }
+
+  void reset() noexcept {
+    if (ops_ != nullptr) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  mutable Storage storage_;
+  const Ops *ops_;
+};
@@ -24,8 +24,10 @@ public:
 
   /* On success, returns a non-negative integer that is
    * a descriptor for the accepted socket, which has been
-   * set to non-blocking and close-on-exec. *peeraddr is assigned.
+   * set to non-blocking and close-on-exec (flags of accept4).
+   * *peeraddr is assigned.
    * On error, -1 is returned, and *peeraddr is untouched. */
+  int accept(InetAddress *peeraddr, int flags);
   int accept(InetAddress *peeraddr);
 
   void shutdownWrite();
@@ -35,6 +37,13 @@ public:
   void setReuseAddr(bool on); // Enable/disable SO_REUSEADDR
   void setReusePort(bool on); // Enable/disable SO_REUSEPORT
   void setKeepAlive(bool on); // Enable/disable SO_KEEPALIVE
+  // 设置 SO_BUSY_POLL，阻塞读时忙轮询 usecs 微秒，0 表示关闭
+  void setBusyPoll(int usecs);
+  /* 设置监听 socket 的 TCP_DEFER_ACCEPT，连接上有数据到达(或者超过
+   * seconds 秒)才被 accept 唤醒，0 表示关闭 */
+  void setDeferAccept(int seconds);
+  // Enable/disable SO_ZEROCOPY，内核不支持时返回 false
+  bool setZeroCopy(bool on);
 
 private:
   const int sockfd_;
@@ -2,13 +2,20 @@
 
 #include "Buffer.h"
 #include "Callbacks.h"
+#include "ChainBuffer.h"
 #include "InetAddress.h"
 #include "Timestamp.h"
+#include "TimingWheel.h"
 #include "noncopyable.h"
 
+#include <algorithm>
 #include <atomic>
+#include <deque>
 #include <memory>
+#include <stdint.h>
 #include <string>
+#include <sys/types.h>
+#include <vector>
 
 class Channel;
 class EventLoop;
@@ -35,9 +42,58 @@ public:
 
   bool connected() const { return state_ == kConnected; }
 
+  /* Thread safe. 在 loop 线程中直接发送，不拷贝；在其他线程中调用时，
+   * 数据的所有权转移到 loop 线程，至多拷贝一次：
+   *   send(const std::string&) 和 send(const void*, size_t) 拷贝一次
+   *   send(std::string&&) 移动，不拷贝
+   *   send(Buffer*) 和 buf 交换，不拷贝(使用 SlabPool 的 Buffer 拷贝一次)
+   * 返回后 buf 被清空 */
   void send(const std::string &buf);
+  void send(std::string &&buf);
+  void send(const void *data, size_t len);
+  void send(Buffer *buf);
+
+  /* 分散/聚集发送：多块数据按顺序用一次 writev 发出，不先拼接到一起。
+   * 在 loop 线程中没发完的部分拷贝到 outputBuffer_；其他线程中调用时
+   * 拷贝一次。Thread safe. */
+  void sendv(const struct iovec *pieces, int count);
+  /* pieces 的所有权转移给连接，没发完的部分也不拷贝：排在 outputBuffer_
+   * 之后，由 handleWrite 和 outputBuffer_ 的数据合并成一次 writev 发送
+   * Thread safe. */
+  void sendv(std::vector<std::string> &&pieces);
+
+  /* 用 sendfile(2) 发送文件 fd 中 [offset, offset + length) 的数据，
+   * 不经过用户态缓冲区。和 send 的数据按调用顺序发送，整段发送完成之后
+   * 回调 writeCompleteCallback。fd 会被 dup，调用者可以随即关闭自己的 fd
+   * Thread safe. */
+  void sendFile(int fd, off_t offset, size_t length);
+
+  /* 零拷贝发送 [data, data + len)：不超过 zeroCopyThreshold 或者没有启用时
+   * 退化为普通的 send(拷贝后立即释放 owner)；否则以 MSG_ZEROCOPY 发送，
+   * owner 持有数据直到内核通知这些数据已经不再被引用。在此之前数据必须保持
+   * 不变。和 send 的数据按调用顺序发送。Thread safe. */
+  void sendZeroCopy(const void *data, size_t len,
+                    std::shared_ptr<const void> owner);
+  void sendZeroCopy(const std::shared_ptr<const std::string> &payload);
   void shutdown(); // NOT thread safe, no simultaneous calling
 
+  /* 开始/暂停读取，即在 Channel 上打开/关闭 EPOLLIN；暂停期间数据留在
+   * 内核的接收缓冲区，由 TCP 流量控制让对端放慢。Thread safe. */
+  void startRead();
+  void stopRead();
+  bool isReading() const { return reading_; } // NOT thread safe
+
+  /* 读端背压：待发送的数据(outputBuffer_、文件和内存段)达到 highWaterMark
+   * 时自动暂停读，回落到 lowWaterMark(含)以下时自动恢复，使得向慢速对端
+   * 转发数据时内存有上界。lowWaterMark 超过 highWaterMark 时按 highWaterMark
+   * 处理。0 表示不启用(默认)。在 loop 线程中或者 connectEstablished() 之前
+   * 调用 */
+  void setBackpressure(size_t highWaterMark, size_t lowWaterMark) {
+    pauseReadMark_ = highWaterMark;
+    resumeReadMark_ = std::min(lowWaterMark, highWaterMark);
+  }
+  void forceClose(); // 不等待 outputBuffer_ 发送完毕，直接关闭连接
+
   void setConnectionCallback(const ConnectionCallback &cb) {
     connectionCallback_ = cb;
   }
@@ -57,6 +113,33 @@ public:
   /// Internal use only.
   void setCloseCallback(const CloseCallback &cb) { closeCallback_ = cb; }
 
+  /* 以边缘触发模式注册 channel，读写时一直进行到 EAGAIN
+   * 必须在 connectEstablished() 之前调用 */
+  void setEdgeTriggered(bool on);
+
+  /* 空闲超时：seconds 秒内没有任何读写就关闭连接
+   * 读超时：seconds 秒内没有读到数据就关闭连接
+   * 0 表示不启用，由所属 EventLoop 的时间轮驱动，精度为一个 tick(1 秒)
+   * 必须在 connectEstablished() 之前调用 */
+  void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
+  void setReadTimeout(double seconds) { readTimeout_ = seconds; }
+
+  // 设置 socket 的 SO_BUSY_POLL，单位为微秒
+  void setBusyPoll(int usecs);
+
+  /* 启用 SO_ZEROCOPY，sendZeroCopy 超过 threshold 字节的数据以 MSG_ZEROCOPY
+   * 发送；0 表示不启用(默认)。内核不支持时退化为普通发送。
+   * 必须在 connectEstablished() 之前调用 */
+  void setZeroCopyThreshold(size_t threshold) {
+    zeroCopyThreshold_ = threshold;
+  }
+
+  /* auto-cork：同一轮事件处理中 send 的数据先积累在 outputBuffer_，
+   * 事件处理结束后(以及执行完 pending functors 之后)合并为一次
+   * write/writev 发送，减少系统调用和小的 TCP 分节；延迟不超过一轮 loop
+   * 在 loop 线程中或者 connectEstablished() 之前调用 */
+  void setAutoCork(bool on) { autoCork_ = on; }
+
   // called when TcpServer accepts a new connection
   void connectEstablished(); // should be called only once
   // called when TcpServer has removed me from its map
@@ -67,12 +150,72 @@ private:
   void setState(StateE state) { state_ = state; }
 
   void handleRead(Timestamp receiveTime); // 处理读事件
+  void adjustReadSize(size_t n);          // 根据本次读到的字节数调整 readSize_
   void handleWrite();
   void handleClose();
   void handleError();
 
   void sendInLoop(const void *message, size_t len);
+  /* 没有发完的数据：owner 为空时拷贝到 outputBuffer_，
+   * 否则作为内存段排队，由 owner 持有 */
+  void sendvInLoop(const struct iovec *pieces, int count,
+                   const std::shared_ptr<const void> &owner);
+  void sendPiecesInLoop(
+      const std::shared_ptr<std::vector<std::string>> &pieces);
+  // 供其他线程的 send 绑定，数据由 functor 持有
+  void sendStringInLoop(const std::string &message) {
+    sendInLoop(message.data(), message.size());
+  }
+  void sendBufferInLoop(const Buffer &buf) {
+    sendInLoop(buf.peek(), buf.readableBytes());
+  }
+  void sendFileInLoop(int fd, off_t offset, size_t length);
+  void sendZeroCopyInLoop(const void *data, size_t len,
+                          const std::shared_ptr<const void> &owner);
+
+  struct OutputSegment;
+  // 把文件或者内存段排在 outputBuffer_ 已有的数据之后
+  void queueSegment(const OutputSegment &segment);
+
+  /* 发送一段待发送的数据：轮到的文件或零拷贝 segment，或者在此之前的
+   * outputBuffer_ 数据和 sendv 内存段；返回值和 errno 的含义同 write */
+  ssize_t writeOutput(int *savedErrno);
+  ssize_t writeSegment(OutputSegment *segment, int *savedErrno);
+  void startReadInLoop();
+  void handleDeferredRead(); // startReadInLoop 补的一次读
+  void stopReadInLoop();
+  void updateBackpressure(); // 根据待发送的数据量暂停或恢复读
+
+  void flushOutput();   // 发送 auto-cork 积累的数据
+  void scheduleFlush(); // 本轮结束时调用 flushOutput
+  void outputDrained(); // 待发送的数据全部发送完成
+  size_t outputBytes() const {
+    return outputBuffer_.readableBytes() + segmentBytes_;
+  }
+  bool hasPendingOutput() const {
+    return outputBuffer_.readableBytes() > 0 || !segments_.empty();
+  }
+  void clearSegments();
+
+  /* 读取 MSG_ERRQUEUE 中的零拷贝完成通知，释放对应的 owner；
+   * 只有完成通知、没有其他错误时返回 true */
+  bool handleZeroCopyCompletions();
+  void completeZeroCopy(uint32_t lo, uint32_t hi);
   void shutdownInLoop();
+  void forceCloseInLoop();
+
+  /* queueInLoop 时绑定成员函数和 shared_ptr，而不是拷贝一份用户的
+   * std::function，保证可以存放在 Functor 的内部存储中 */
+  void runWriteCompleteCallback() {
+    writeCompleteCallback_(shared_from_this());
+  }
+  void runHighWaterMarkCallback(size_t len) {
+    highWaterMarkCallback_(shared_from_this(), len);
+  }
+
+  // 时间轮回调，what 为 "idle" 或 "read"
+  void handleTimeout(const char *what);
+  void removeTimeouts(); // 从时间轮中摘除
 
   EventLoop *loop_; // 所属的 EventLoop(subLoop, 即 subReactor)
   const std::string name_;
@@ -94,6 +237,59 @@ private:
   CloseCallback closeCallback_;
   size_t highWaterMark_;
 
+  double idleTimeout_;
+  double readTimeout_;
+  TimingWheel *timingWheel_; // 启用了超时才指向所属 loop 的时间轮
+  TimingWheel::Entry idleEntry_; // 读写时 touch
+  TimingWheel::Entry readEntry_; // 读到数据时 touch
+
+  /* 自适应的读取量：读满就翻倍，连续两次不足四分之一就减半，
+   * 每次读之前在 inputBuffer_ 中预留 readSize_ 字节 */
+  size_t readSize_;
+  int readShrinkVotes_;
+
   Buffer inputBuffer_;  // 接收数据的缓冲区
-  Buffer outputBuffer_; // 发送数据的缓冲区
+  ChainBuffer outputBuffer_; // 发送数据的缓冲区，按 slab 分段，writev 发送
+
+  /* 不经过 outputBuffer_ 的待发送数据：
+   * fd >= 0 时为 sendfile 的文件段，否则为内存段；内存段中 zeroCopy 的
+   * 以 MSG_ZEROCOPY 单独发送，其余的(sendv)和 outputBuffer_ 合并 writev */
+  struct OutputSegment {
+    int fd; // dup 出来的，发送完关闭
+    off_t offset;
+    const char *data;
+    size_t remaining;
+    // 在 outputBuffer_ 的发送流中的位置，这之前的数据发送完才轮到这一段
+    uint64_t position;
+    std::shared_ptr<const void> owner; // 持有内存段的数据
+    bool zeroCopy;                     // 以 MSG_ZEROCOPY 发送的内存段
+    // 已经以 MSG_ZEROCOPY 发送过，对应 zeroCopyPending_ 的最后一项
+    bool zeroCopied;
+  };
+  std::deque<OutputSegment> segments_;
+  uint64_t outputQueued_; // 累计追加到 outputBuffer_ 的字节数
+  uint64_t outputSent_;   // 累计从 outputBuffer_ 发送出去的字节数
+  size_t segmentBytes_;   // segments_ 中还没有发送的字节数
+  /* shutdownInLoop 已经执行，等待发送完成后关闭写端。其他线程调用 shutdown
+   * 时 state_ 立即变为 kDisconnecting，但在此之前投递的 send 还没有执行，
+   * handleWrite 不能只凭 state_ 关闭写端 */
+  bool shutdownPending_;
+  bool autoCork_;
+  bool flushQueued_; // 已经提交了 flushOutput，还没有执行
+  bool readPaused_;      // 读被 updateBackpressure 自动暂停
+  bool readDrainCut_;    // 边缘触发模式下暂停读时内核中还有数据
+  size_t pauseReadMark_; // 0 表示不启用读端背压
+  size_t resumeReadMark_;
+
+  // 等待内核完成通知的零拷贝数据，发送次数的通知序号是连续的
+  struct ZeroCopyPending {
+    uint32_t firstSeq;
+    uint32_t count;     // 还没有收到通知的发送次数
+    uint32_t completed; // 已经收到通知的发送次数
+    bool sending;       // 这一段是否还在发送
+    std::shared_ptr<const void> owner;
+  };
+  size_t zeroCopyThreshold_;
+  uint32_t zeroCopySeq_; // 下一次 MSG_ZEROCOPY 发送的通知序号，和内核保持一致
+  std::deque<ZeroCopyPending> zeroCopyPending_;
 };
\ No newline at end of file
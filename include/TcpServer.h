@@ -12,8 +12,10 @@
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 /*
  * TCP server, supports single-threaded and thread-pool models.
@@ -27,6 +29,11 @@ public:
   enum Option {
     kNoReusePort,
     kReusePort,
+    /* 每个 io loop 各有一个绑定同一地址的 SO_REUSEPORT 监听 socket，
+     * 由内核把新连接分散到各个 loop，在 accept 的线程中直接建立连接，
+     * 不经过 mainLoop 转发。析构 TcpServer 时要在各个 io loop 中销毁
+     * Acceptor，所以 TcpServer 析构之前 io loop 不能退出 */
+    kReusePortPerLoop,
   };
 
   TcpServer(EventLoop *loop, const InetAddress &listenAddr,
@@ -55,9 +62,51 @@ public:
     writeCompleteCallback_ = cb;
   }
 
+  /* Set edge-triggered mode for new connections. Not thread safe.
+   * 新连接以 EPOLLET 注册，读写时一直进行到 EAGAIN，默认为水平触发 */
+  void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+  /* Set idle/read timeout for new connections. Not thread safe.
+   * 超时的连接由各自 subLoop 的时间轮批量关闭，0 表示不启用 */
+  void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
+  void setReadTimeout(double seconds) { readTimeout_ = seconds; }
+
+  /* Set auto-cork for new connections. Not thread safe.
+   * 见 TcpConnection::setAutoCork，默认不启用 */
+  void setAutoCork(bool on) { autoCork_ = on; }
+
+  /* Set read backpressure for new connections. Not thread safe.
+   * 见 TcpConnection::setBackpressure，0 表示不启用 */
+  void setBackpressure(size_t highWaterMark, size_t lowWaterMark) {
+    pauseReadMark_ = highWaterMark;
+    resumeReadMark_ = lowWaterMark;
+  }
+
+  /* Set MSG_ZEROCOPY threshold for new connections. Not thread safe.
+   * 见 TcpConnection::setZeroCopyThreshold，0 表示不启用 */
+  void setZeroCopyThreshold(size_t threshold) {
+    zeroCopyThreshold_ = threshold;
+  }
+
+  /* Set busy polling for io loops. Must be called before @c start.
+   * spinPolls 见 EventLoop::setSpinPolls；usecs > 0 时同时设置 epoll 的
+   * 内核 busy poll 参数和新连接的 SO_BUSY_POLL，内核不支持时忽略 */
+  void setBusyPoll(int spinPolls, int usecs = 0, int budget = 8) {
+    busyPollSpins_ = spinPolls;
+    busyPollUsecs_ = usecs;
+    busyPollBudget_ = budget;
+  }
+
+  /* Set accept options of the listening socket(s). Must be called before
+   * @c start. 见 Acceptor::setAcceptBatch/setAcceptFlags/setDeferAccept */
+  void setAcceptBatch(int batch) { acceptBatch_ = batch; }
+  void setAcceptFlags(int flags) { acceptFlags_ = flags; }
+  void setDeferAccept(int seconds) { deferAcceptSeconds_ = seconds; }
+
   /* Set the number of threads for handling input.
    *
-   * Always accepts new connection in loop's thread.
+   * Accepts new connection in loop's thread, or in each io loop's thread
+   * with kReusePortPerLoop.
    * Must be called before @c start
    * @param numThreads
    * - 0 means all I/O in loop's thread, no thread will created.
@@ -78,6 +127,9 @@ public:
 private:
   /* Not thread safe, but in loop */
   void newConnection(int sockfd, const InetAddress &peerAddr);
+  // 在 ioLoop 中建立连接；kReusePortPerLoop 模式下由 ioLoop 的 Acceptor 调用
+  void newConnectionInLoop(EventLoop *ioLoop, int sockfd,
+                           const InetAddress &peerAddr);
 
   /* Thread safe. */
   void removeConnection(const TcpConnectionPtr &conn);
@@ -85,15 +137,26 @@ private:
   /* Not thread safe, but in loop */
   void removeConnectionInLoop(const TcpConnectionPtr &conn);
 
+  void configureAcceptor(Acceptor *acceptor); // 应用 accept 相关的设置
+
+  // io loop 线程的初始化，设置 busy poll 之后调用用户的 threadInitCallback_
+  void initLoop(EventLoop *loop);
+
   using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
 
   EventLoop *loop_; // the acceptor loop(即 mainLoop)
 
-  const std::string ipPort_; // 服务器监听的 IP 和端口
+  const InetAddress listenAddr_;
+  /* 服务器监听的 IP 和端口。kReusePortPerLoop 模式下端口为 0 时在 start()
+   * 中改为内核分配的端口 */
+  std::string ipPort_;
   const std::string name_;   // 服务器的名称
+  const Option option_;
 
   /* avoid revealing Acceptor */
   std::unique_ptr<Acceptor> acceptor_; // 运行在 mainLoop，监听新连接事件
+  // kReusePortPerLoop 模式下每个 io loop 的 Acceptor，只在各自的线程中使用
+  std::vector<std::unique_ptr<Acceptor>> loopAcceptors_;
 
   // EventLoopThreadPool 的共享指针，它管理多个 EventLoop 以在不同线程中处理连接
   std::shared_ptr<EventLoopThreadPool> threadPool_; // one loop per thread
@@ -105,7 +168,22 @@ private:
   ThreadInitCallback threadInitCallback_; // loop 线程初始化回调
 
   std::atomic_int started_; // 标记服务器是否已启动
-
-  int nextConnId_;            // 下一个连接的 ID
+  bool edgeTriggered_;      // 新连接是否使用边缘触发模式
+  double idleTimeout_;      // 新连接的空闲超时，单位为秒
+  double readTimeout_;      // 新连接的读超时，单位为秒
+  int busyPollSpins_;       // io loop 阻塞等待前 0 超时轮询的次数
+  int busyPollUsecs_;       // 内核 busy poll 的时长，单位为微秒
+  int busyPollBudget_;      // 内核 busy poll 每次处理的包数
+  size_t zeroCopyThreshold_; // 新连接零拷贝发送的阈值，单位为字节
+  bool autoCork_;            // 新连接是否合并一轮中的发送
+  size_t pauseReadMark_;     // 新连接暂停读的待发送数据量
+  size_t resumeReadMark_;    // 新连接恢复读的待发送数据量
+  int acceptBatch_;          // 每次可读事件最多 accept 的连接数
+  int acceptFlags_;          // accept4 的 flags
+  int deferAcceptSeconds_;   // 监听 socket 的 TCP_DEFER_ACCEPT
+
+  std::atomic_int nextConnId_; // 下一个连接的 ID
+  /* kReusePortPerLoop 模式下各个 io loop 同时增删连接 */
+  std::mutex mutex_;
   ConnectionMap connections_; // 保存所有的连接
 };
\ No newline at end of file
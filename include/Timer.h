@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Callbacks.h"
+#include "Timestamp.h"
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stddef.h>
+
+/* Internal class for timer event.
+ * 一个定时器：到期时间、回调、重复间隔，以及它在 TimerQueue 堆中的位置 */
+class Timer : noncopyable {
+public:
+  static const size_t kNotInHeap = static_cast<size_t>(-1);
+
+  Timer(TimerCallback cb, Timestamp when, double interval)
+      : callback_(std::move(cb)), expiration_(when), interval_(interval),
+        repeat_(interval > 0.0), sequence_(++s_numCreated_),
+        heapIndex_(kNotInHeap) {}
+
+  void run() const { callback_(); }
+
+  Timestamp expiration() const { return expiration_; }
+  bool repeat() const { return repeat_; }
+  int64_t sequence() const { return sequence_; }
+
+  // 重复定时器以 now 为基准，计算下一次到期时间
+  void restart(Timestamp now);
+
+  // for TimerQueue
+  size_t heapIndex() const { return heapIndex_; }
+  void set_heapIndex(size_t index) { heapIndex_ = index; }
+
+  static int64_t numCreated() { return s_numCreated_; }
+
+private:
+  const TimerCallback callback_;
+  Timestamp expiration_;
+  const double interval_; // 重复间隔，单位为秒，0 表示只执行一次
+  const bool repeat_;
+  const int64_t sequence_; // 全局唯一的序号，TimerId 通过它找到定时器
+  size_t heapIndex_;       // 在 TimerQueue 最小堆中的下标
+
+  static std::atomic<int64_t> s_numCreated_;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+/* An opaque identifier, for canceling Timer.
+ * 只保存定时器的序号，定时器已经到期被释放后再 cancel 也是安全的 */
+class TimerId {
+public:
+  TimerId() : sequence_(0) {}
+  explicit TimerId(int64_t sequence) : sequence_(sequence) {}
+
+  friend class TimerQueue;
+
+private:
+  int64_t sequence_;
+};
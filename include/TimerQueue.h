@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Callbacks.h"
+#include "Channel.h"
+#include "TimerId.h"
+#include "Timestamp.h"
+#include "noncopyable.h"
+
+#include <unordered_map>
+#include <vector>
+
+class EventLoop;
+class Timer;
+
+/*
+ * A best efforts timer queue.
+ * No guarantee that the callback will be on time.
+ *
+ * 1. 每个 EventLoop 一个 TimerQueue，所有定时器共用一个 timerfd，
+ *    timerfd 作为普通的 Channel 注册到 Poller 中，到期回调在 loop 线程执行
+ * 2. 定时器按到期时间保存在数组实现的最小堆中，堆节点只有 16 字节，
+ *    Timer 记录自己在堆中的下标，插入和取消都是 O(log n)
+ * 3. 只有最早到期时间发生变化时才调用 timerfd_settime
+ */
+class TimerQueue : noncopyable {
+public:
+  explicit TimerQueue(EventLoop *loop);
+  ~TimerQueue();
+
+  /* Schedules the callback to be run at given time,
+   * repeats if @c interval > 0.0.
+   *
+   * Must be thread safe. Usually be called from other threads. */
+  TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+
+  void cancel(TimerId timerId); // Must be thread safe.
+
+private:
+  // 堆节点，到期时间直接存放在节点里，比较时不需要解引用 Timer
+  struct Entry {
+    int64_t when; // 到期时间，自 Unix 纪元以来的微秒数
+    Timer *timer;
+  };
+
+  void addTimerInLoop(Timer *timer);
+  void cancelInLoop(TimerId timerId);
+
+  // called when timerfd alarms
+  void handleRead();
+
+  // 最小堆操作，维护 Timer 中记录的堆下标
+  void heapPush(Timer *timer);
+  void heapRemove(size_t index);
+  void siftUp(size_t index);
+  void siftDown(size_t index);
+  void heapSet(size_t index, const Entry &entry);
+
+  // 把 timerfd 设置为在 expiration 时刻到期
+  void resetTimerfd(Timestamp expiration);
+
+  EventLoop *loop_;
+  const int timerfd_;
+  Channel timerfdChannel_;
+
+  std::vector<Entry> heap_; // 按到期时间排序的最小堆
+  // {sequence, Timer *}，所有未释放的定时器，用于 cancel 时校验 TimerId
+  std::unordered_map<int64_t, Timer *> activeTimers_;
+  std::vector<Timer *> expired_; // scratch variable，本次到期的定时器
+  int64_t armedExpiration_;      // timerfd 当前设置的到期时间
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <stdint.h>
 #include <string>
 
 class Timestamp {
@@ -13,11 +14,48 @@ public:
 
   // 静态成员函数，返回当前时间的 Timestamp 对象
   static Timestamp now();
+  static Timestamp invalid() { return Timestamp(); } // 无效的时间戳
 
-  // 将时间转换为字符串表示形式
+  /* 当前线程缓存的时间，EventLoop 每次 poll 返回后刷新为 pollReturnTime，
+   * 供定时器和日志使用，省去一次取时间；没有运行 EventLoop 的线程返回 now() */
+  static Timestamp cachedNow();
+  static void setCachedNow(Timestamp now);
+
+  // 将时间转换为字符串表示形式，格式为 "YYYY/MM/DD HH:MM:SS.uuuuuu"
   std::string toString() const;
 
+  /* 同 toString()，写入 buf 并返回长度(不含 '\0')，不分配内存
+   * buf 的长度至少为 kFormattedSize */
+  int formatTo(char *buf) const;
+  static const int kFormattedSize = 32;
+
+  bool valid() const { return microSecondsSinceEpoch_ > 0; }
+  int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+
+  static const int kMicroSecondsPerSecond = 1000 * 1000;
+
 private:
   // 成员变量，保存自 Unix 纪元以来的微秒数
   int64_t microSecondsSinceEpoch_;
 };
+
+inline bool operator<(Timestamp lhs, Timestamp rhs) {
+  return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs) {
+  return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间戳的差值，单位为秒
+inline double timeDifference(Timestamp high, Timestamp low) {
+  int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+  return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// 在 timestamp 的基础上增加 seconds 秒
+inline Timestamp addTime(Timestamp timestamp, double seconds) {
+  int64_t delta =
+      static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+  return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "TimerId.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class EventLoop;
+
+/*
+ * Hashed timing wheel for coarse-grained timeouts, eg. idle connections.
+ *
+ * 1. 每个 EventLoop 至多一个，由 EventLoop::runEvery 按 tick 驱动，
+ *    所有操作都必须在 loop 线程中进行
+ * 2. Entry 是侵入式的双向链表节点，由使用者(TcpConnection)持有，
+ *    挂入和摘除都不需要分配内存
+ * 3. touch 只更新 Entry 的截止 tick，是一次 O(1) 的写操作，不移动链表节点；
+ *    每个 tick 只检查当前槽位，未到期的 Entry 按新的截止 tick 重新挂到对应槽位，
+ *    到期的 Entry 一起摘下后批量回调
+ */
+class TimingWheel : noncopyable {
+public:
+  using TimeoutCallback = std::function<void()>;
+
+  class Entry : noncopyable {
+  public:
+    Entry() : prev_(nullptr), next_(nullptr), bucket_(kNotLinked),
+              deadline_(0), timeoutTicks_(0) {}
+
+    void setTimeoutCallback(TimeoutCallback cb) { callback_ = std::move(cb); }
+    bool linked() const { return bucket_ != kNotLinked; }
+
+  private:
+    friend class TimingWheel;
+    static const size_t kNotLinked = static_cast<size_t>(-1);
+
+    Entry *prev_;
+    Entry *next_;
+    size_t bucket_;         // 所在的槽位
+    int64_t deadline_;      // 截止 tick，touch 时刷新
+    int64_t timeoutTicks_;  // 超时时长，单位为 tick
+    TimeoutCallback callback_;
+  };
+
+  TimingWheel(EventLoop *loop, double tickSeconds, size_t numBuckets);
+  ~TimingWheel();
+
+  // 挂入 entry，timeoutSeconds 秒(精度为一个 tick)内没有 touch 就回调
+  void add(Entry *entry, double timeoutSeconds);
+  // 刷新 entry 的截止时间
+  void touch(Entry *entry) {
+    entry->deadline_ = currentTick_ + entry->timeoutTicks_;
+  }
+  // 摘除 entry，未挂入时什么也不做
+  void remove(Entry *entry);
+
+  size_t size() const { return size_; }
+  double tickSeconds() const { return tickSeconds_; }
+
+private:
+  void link(Entry *entry, size_t bucket);
+  void unlink(Entry *entry);
+
+  void onTick(); // 每个 tick 处理一个槽位
+
+  EventLoop *loop_;
+  const double tickSeconds_;
+  TimerId tickTimer_;
+  std::vector<Entry *> buckets_; // 每个槽位一个链表
+  int64_t currentTick_;
+  size_t size_;                 // 挂入的 entry 总数
+  std::vector<Entry *> expired_; // scratch variable，本 tick 到期的 entry
+};
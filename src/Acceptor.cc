@@ -3,6 +3,8 @@
 #include "Logger.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <strings.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -19,7 +21,9 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr,
                    bool reuseport)
     : loop_(loop), acceptSocket_(createNonblocking()),
       acceptChannel_(loop /*baseloop*/, acceptSocket_.fd()) /*注册到 Poller */,
-      listenning_(false) {
+      listenning_(false), acceptBatch_(kDefaultAcceptBatch),
+      acceptFlags_(SOCK_NONBLOCK | SOCK_CLOEXEC), deferAcceptSeconds_(0),
+      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)) {
   acceptSocket_.setReuseAddr(true);      // 设置地址重用
   acceptSocket_.setReusePort(reuseport); // 设置端口重用
   acceptSocket_.bindAddress(listenAddr); // 绑定监听地址和端口
@@ -31,31 +35,68 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr,
 Acceptor::~Acceptor() {
   acceptChannel_.disableAll();
   acceptChannel_.remove();
+  if (idleFd_ >= 0)
+    ::close(idleFd_);
 }
 
 void Acceptor::listen() {
   listenning_ = true;
+  if (deferAcceptSeconds_ > 0)
+    acceptSocket_.setDeferAccept(deferAcceptSeconds_);
   acceptSocket_.listen();         // listen
   acceptChannel_.enableReading(); // 开启 acceptChannel 的读事件，并注册到
                                   // EventLoop(Poller) 中
 }
 
-/* 1. 从 listenfd 上 accept 新的连接
+InetAddress Acceptor::localAddress() const {
+  sockaddr_in local;
+  ::bzero(&local, sizeof local);
+  socklen_t addrlen = sizeof local;
+  if (::getsockname(acceptSocket_.fd(), (sockaddr *)&local, &addrlen) < 0)
+    LOG_ERROR("Acceptor::localAddress");
+  return InetAddress(local);
+}
+
+/* 1. 从 listenfd 上 accept 新的连接，一次可读事件最多 accept acceptBatch_ 个，
+ *    突发的大量连接不需要同样多轮的 loop
  * 2. 将新连接的 fd 设置为非阻塞模式
  * 3. 将新连接加入到 SubReactor 的 EventLoop 中 */
 void Acceptor::handleRead() {
-  InetAddress peerAddr;
-  int connfd = acceptSocket_.accept(&peerAddr);
-  if (connfd >= 0)
-    if (newConnectionCallback_)
-      newConnectionCallback_(connfd, peerAddr);
-    else
-      ::close(connfd);
-  else {
-    LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__,
-              errno);
-    if (errno == EMFILE)
+  for (int i = 0; i < acceptBatch_; ++i) {
+    InetAddress peerAddr;
+    int connfd = acceptSocket_.accept(&peerAddr, acceptFlags_ | SOCK_NONBLOCK);
+    if (connfd >= 0) {
+      if (newConnectionCallback_)
+        newConnectionCallback_(connfd, peerAddr);
+      else
+        ::close(connfd);
+      continue;
+    }
+
+    const int savedErrno = errno;
+    if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
+      break; // 已经没有待接受的连接
+    if (savedErrno == EMFILE || savedErrno == ENFILE) {
       LOG_ERROR("%s:%s:%d sockfd reached limit! \n", __FILE__, __FUNCTION__,
                 __LINE__);
+      shedConnection();
+      continue;
+    }
+    LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__,
+              savedErrno);
+    // 连接在 accept 之前被对端重置等暂时性错误，继续接受后面的连接
+    if (savedErrno != ECONNABORTED && savedErrno != EINTR &&
+        savedErrno != EPROTO && savedErrno != EPERM)
+      break;
   }
+}
+
+void Acceptor::shedConnection() {
+  if (idleFd_ < 0) // 之前没能重新占住 idleFd_
+    return;
+  ::close(idleFd_);
+  idleFd_ = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+  if (idleFd_ >= 0)
+    ::close(idleFd_);
+  idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
 }
\ No newline at end of file
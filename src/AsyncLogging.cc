@@ -0,0 +1,134 @@
+#include "AsyncLogging.h"
+#include "LogFile.h"
+#include "Timestamp.h"
+
+#include <chrono>
+#include <stdio.h>
+
+AsyncLogging::AsyncLogging(const std::string &basename, off_t rollSize,
+                           int flushInterval)
+    : flushInterval_(flushInterval), basename_(basename), rollSize_(rollSize),
+      running_(false),
+      thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging"),
+      currentBuffer_(new LogBuffer), nextBuffer_(new LogBuffer),
+      flushRequested_(0), flushCompleted_(0) {
+  buffers_.reserve(16);
+}
+
+AsyncLogging::~AsyncLogging() {
+  if (running_)
+    stop();
+}
+
+void AsyncLogging::start() {
+  running_ = true;
+  thread_.start();
+}
+
+void AsyncLogging::stop() {
+  running_ = false;
+  cond_.notify_one();
+  thread_.join();
+}
+
+void AsyncLogging::append(const char *logline, int len) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (currentBuffer_->avail() > static_cast<size_t>(len))
+    currentBuffer_->append(logline, len);
+  else { // 当前缓冲区写满，交给后台线程
+    buffers_.push_back(std::move(currentBuffer_));
+    if (nextBuffer_)
+      currentBuffer_ = std::move(nextBuffer_);
+    else // 前端写得太快，两块缓冲区都用完了，再分配一块(很少发生)
+      currentBuffer_.reset(new LogBuffer);
+    currentBuffer_->append(logline, len);
+    cond_.notify_one();
+  }
+}
+
+void AsyncLogging::flush() {
+  if (!running_)
+    return;
+  std::unique_lock<std::mutex> lock(mutex_);
+  const int64_t request = ++flushRequested_;
+  cond_.notify_one();
+  flushCond_.wait(lock, [&] { return flushCompleted_ >= request; });
+}
+
+/*
+ * 1. 准备两块空闲缓冲区，用来替换前端的 currentBuffer_ 和 nextBuffer_
+ * 2. 在锁内交换出待写入的缓冲区，临界区内只有指针操作
+ * 3. 在锁外写入文件，把其中两块缓冲区留下来作为下一轮的空闲缓冲区
+ */
+void AsyncLogging::threadFunc() {
+  LogFile output(basename_, rollSize_, flushInterval_);
+  BufferPtr newBuffer1(new LogBuffer);
+  BufferPtr newBuffer2(new LogBuffer);
+  BufferVector buffersToWrite;
+  buffersToWrite.reserve(16);
+
+  bool exiting = false;
+  while (!exiting) {
+    int64_t flushRequest = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (buffers_.empty() && running_ &&
+          flushRequested_ == flushCompleted_)
+        cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+      exiting = !running_;
+      flushRequest = flushRequested_;
+
+      buffers_.push_back(std::move(currentBuffer_));
+      currentBuffer_ = std::move(newBuffer1);
+      buffersToWrite.swap(buffers_);
+      if (!nextBuffer_)
+        nextBuffer_ = std::move(newBuffer2);
+    }
+
+    // 积压太多时只保留最早的两块，丢弃其余的日志
+    if (buffersToWrite.size() > 25) {
+      char buf[256];
+      snprintf(buf, sizeof buf,
+               "Dropped log messages at %s, %zu larger buffers\n",
+               Timestamp::now().toString().c_str(), buffersToWrite.size() - 2);
+      fputs(buf, stderr);
+      output.append(buf, strlen(buf));
+      buffersToWrite.erase(buffersToWrite.begin() + 2, buffersToWrite.end());
+    }
+
+    for (const BufferPtr &buffer : buffersToWrite)
+      if (buffer->length() > 0)
+        output.append(buffer->data(), buffer->length());
+
+    // 回收两块缓冲区作为下一轮的 newBuffer1 和 newBuffer2
+    if (buffersToWrite.size() > 2)
+      buffersToWrite.resize(2);
+    if (!newBuffer1) {
+      newBuffer1 = std::move(buffersToWrite.back());
+      buffersToWrite.pop_back();
+      newBuffer1->reset();
+    }
+    if (!newBuffer2 && !buffersToWrite.empty()) {
+      newBuffer2 = std::move(buffersToWrite.back());
+      buffersToWrite.pop_back();
+      newBuffer2->reset();
+    }
+    if (!newBuffer2) // 这一轮只交换出一块缓冲区
+      newBuffer2.reset(new LogBuffer);
+    buffersToWrite.clear();
+    output.flush();
+
+    if (flushRequest != 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (flushRequest > flushCompleted_) {
+        flushCompleted_ = flushRequest;
+        flushCond_.notify_all();
+      }
+    }
+  }
+  output.flush();
+
+  std::lock_guard<std::mutex> lock(mutex_); // 不让 flush() 的调用者一直等待
+  flushCompleted_ = flushRequested_;
+  flushCond_.notify_all();
+}
@@ -0,0 +1,538 @@
+#include "BinaryLogging.h"
+#include "CurrentThread.h"
+#include "Timestamp.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctype.h>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <pthread.h>
+#include <stdlib.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * 文件格式：
+ *   "MUDUOBL1"
+ *   'F' u32 id, u8 level, u32 line, u16 fileLen, file, u16 fmtLen, fmt
+ *   'L' u32 tid, record(记录头 + 参数，与环形缓冲区中的格式相同)
+ * 格式串一定先于引用它的日志写入文件
+ */
+namespace {
+
+const char kMagic[8] = {'M', 'U', 'D', 'U', 'O', 'B', 'L', '1'};
+const uint32_t kPadding = 0xffffffff; // 环形缓冲区末尾的填充记录
+
+struct FormatInfo {
+  int level;
+  int line;
+  std::string file;
+  std::string fmt;
+};
+
+/* 单个线程的 SPSC 环形缓冲区，位置是单调递增的字节偏移
+ * 生产者(所属线程)只写 writePos，消费者(后台线程)只写 readPos */
+struct ThreadRing {
+  explicit ThreadRing(size_t capacity)
+      : data(new char[capacity]), capacity(capacity), mask(capacity - 1),
+        writePos(0), readPos(0), cachedReadPos(0), dropped(0),
+        tid(CurrentThread::tid()), retired(false) {}
+  ~ThreadRing() { delete[] data; }
+
+  char *const data;
+  const size_t capacity;
+  const size_t mask;
+  alignas(64) std::atomic<uint64_t> writePos;
+  alignas(64) std::atomic<uint64_t> readPos;
+  alignas(64) uint64_t cachedReadPos; // 生产者缓存的 readPos
+  std::atomic<uint64_t> dropped;
+  const int tid;
+  std::atomic_bool retired; // 所属线程已经退出，读空之后释放
+};
+
+/* ThreadRing 的成员按 cache line 对齐，C++11 的 new 不保证超过
+ * max_align_t 的对齐，用 posix_memalign 分配 */
+ThreadRing *newRing(size_t capacity) {
+  void *p = nullptr;
+  if (posix_memalign(&p, alignof(ThreadRing), sizeof(ThreadRing)) != 0)
+    return nullptr;
+  return ::new (p) ThreadRing(capacity);
+}
+
+void deleteRing(ThreadRing *ring) {
+  ring->~ThreadRing();
+  free(ring);
+}
+
+struct State {
+  /* 保护 formats、rings 和 formatsWritten；
+   * file 只由后台线程使用，写文件时不持有 mutex */
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::vector<FormatInfo> formats;
+  std::vector<ThreadRing *> rings;
+  size_t ringBytes = 0;
+  FILE *file = nullptr;
+  size_t formatsWritten = 0; // 已经写入文件的格式串数量
+  bool running = false;
+  std::thread writer;
+  uint64_t droppedRetired = 0; // 已释放的 ring 丢弃的日志条数
+};
+
+State &state() {
+  static State *s = new State; // 不析构，其他线程退出时可能还在使用
+  return *s;
+}
+
+__thread ThreadRing *t_ring = nullptr;
+pthread_key_t g_ringKey;
+pthread_once_t g_ringKeyOnce = PTHREAD_ONCE_INIT;
+
+void retireRing(void *ring) {
+  static_cast<ThreadRing *>(ring)->retired.store(true,
+                                                 std::memory_order_release);
+}
+
+void createRingKey() { pthread_key_create(&g_ringKey, retireRing); }
+
+ThreadRing *currentRing() {
+  if (__builtin_expect(t_ring == nullptr, 0)) {
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.ringBytes == 0) // 还没有 start，或者已经 stop
+      return nullptr;
+    t_ring = newRing(s.ringBytes);
+    if (t_ring == nullptr)
+      return nullptr;
+    s.rings.push_back(t_ring);
+    pthread_once(&g_ringKeyOnce, createRingKey);
+    pthread_setspecific(g_ringKey, t_ring);
+  }
+  return t_ring;
+}
+
+void writeBytes(FILE *file, const void *data, size_t len) {
+  fwrite_unlocked(data, 1, len, file);
+}
+
+// 把新登记的格式串写入文件；只在锁内拷贝出来，在锁外写文件
+void writeNewFormats(State &s) {
+  std::vector<FormatInfo> formats;
+  size_t firstId = 0;
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    firstId = s.formatsWritten;
+    formats.assign(s.formats.begin() + firstId, s.formats.end());
+    s.formatsWritten = s.formats.size();
+  }
+  for (size_t i = 0; i < formats.size(); ++i) {
+    const FormatInfo &f = formats[i];
+    uint32_t id = static_cast<uint32_t>(firstId + i);
+    uint8_t level = static_cast<uint8_t>(f.level);
+    uint32_t line = static_cast<uint32_t>(f.line);
+    uint16_t fileLen = static_cast<uint16_t>(f.file.size());
+    uint16_t fmtLen = static_cast<uint16_t>(f.fmt.size());
+    fputc('F', s.file);
+    writeBytes(s.file, &id, 4);
+    writeBytes(s.file, &level, 1);
+    writeBytes(s.file, &line, 4);
+    writeBytes(s.file, &fileLen, 2);
+    writeBytes(s.file, f.file.data(), fileLen);
+    writeBytes(s.file, &fmtLen, 2);
+    writeBytes(s.file, f.fmt.data(), fmtLen);
+  }
+}
+
+/* 读空一个 ring，返回写入的记录数
+ * 先 acquire writePos，再写新登记的格式串，保证记录引用的格式串已经写入 */
+size_t drainRing(State &s, ThreadRing *ring) {
+  uint64_t r = ring->readPos.load(std::memory_order_relaxed);
+  const uint64_t w = ring->writePos.load(std::memory_order_acquire);
+  if (r == w)
+    return 0;
+
+  writeNewFormats(s);
+  size_t records = 0;
+  const uint32_t tid = static_cast<uint32_t>(ring->tid);
+  while (r < w) {
+    const char *rec = ring->data + (r & ring->mask);
+    uint32_t size, fmtId;
+    memcpy(&size, rec, 4);
+    memcpy(&fmtId, rec + 4, 4);
+    if (fmtId != kPadding) {
+      fputc('L', s.file);
+      writeBytes(s.file, &tid, 4);
+      writeBytes(s.file, rec, size);
+      ++records;
+    }
+    r += size;
+  }
+  ring->readPos.store(r, std::memory_order_release);
+  return records;
+}
+
+/* 读空所有 ring，释放所属线程已经退出的 ring
+ * 只在锁内拷贝 ring 列表，读 ring 和写文件都不持有 mutex，
+ * 不会让 registerFormat 和新线程的第一条日志等待磁盘 I/O */
+size_t drainAll(State &s, std::vector<ThreadRing *> *rings) {
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    *rings = s.rings;
+  }
+
+  size_t records = 0;
+  for (ThreadRing *ring : *rings) {
+    // 先读 retired，再读空，之后不会再有新的记录
+    bool retired = ring->retired.load(std::memory_order_acquire);
+    records += drainRing(s, ring);
+    if (retired) {
+      {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.droppedRetired += ring->dropped.load(std::memory_order_relaxed);
+        s.rings.erase(std::find(s.rings.begin(), s.rings.end(), ring));
+      }
+      deleteRing(ring);
+    }
+  }
+  fflush(s.file);
+  return records;
+}
+
+// 后台线程：有数据时每毫秒读一次，空闲时逐渐退避到 50 毫秒
+void writerFunc() {
+  State &s = state();
+  std::vector<ThreadRing *> rings;
+  int idleMs = 1;
+  std::unique_lock<std::mutex> lock(s.mutex);
+  while (s.running) {
+    lock.unlock();
+    size_t records = drainAll(s, &rings);
+    idleMs = records > 0 ? 1 : std::min(idleMs * 2, 50);
+    lock.lock();
+    s.cond.wait_for(lock, std::chrono::milliseconds(idleMs),
+                    [&s] { return !s.running; });
+  }
+  lock.unlock();
+  drainAll(s, &rings);
+}
+
+} // namespace
+
+std::atomic_bool BinaryLogging::enabled_(false);
+
+bool BinaryLogging::start(const std::string &path, size_t ringBytes) {
+  State &s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  if (s.running)
+    return false;
+
+  FILE *file = fopen(path.c_str(), "we");
+  if (file == nullptr)
+    return false;
+  writeBytes(file, kMagic, sizeof kMagic);
+
+  size_t capacity = 4096;
+  while (capacity < ringBytes)
+    capacity <<= 1;
+  s.ringBytes = capacity;
+  s.file = file;
+  s.formatsWritten = 0;
+  s.running = true;
+  s.writer = std::thread(writerFunc);
+  enabled_.store(true, std::memory_order_release);
+  return true;
+}
+
+void BinaryLogging::stop() {
+  State &s = state();
+  enabled_.store(false, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.running)
+      return;
+    s.running = false;
+  }
+  s.cond.notify_one();
+  s.writer.join();
+
+  /* 仍在运行的线程可能正在写自己的 ring，ring 保留下来，
+   * 再次 start 时继续使用，其中残留的记录会写入新文件 */
+  std::lock_guard<std::mutex> lock(s.mutex);
+  fclose(s.file);
+  s.file = nullptr;
+}
+
+uint64_t BinaryLogging::dropped() {
+  State &s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  uint64_t n = s.droppedRetired;
+  for (ThreadRing *ring : s.rings)
+    n += ring->dropped.load(std::memory_order_relaxed);
+  return n;
+}
+
+int BinaryLogging::registerFormat(int level, const char *file, int line,
+                                  const char *fmt) {
+  State &s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  FormatInfo info;
+  info.level = level;
+  info.line = line;
+  info.file = file;
+  info.fmt = fmt;
+  s.formats.push_back(std::move(info));
+  return static_cast<int>(s.formats.size() - 1);
+}
+
+/* 在本线程的 ring 中预留 size 字节的连续空间
+ * 末尾剩余的连续空间不够时，写一条填充记录，从头开始 */
+char *BinaryLogging::reserve(size_t size) {
+  ThreadRing *ring = currentRing();
+  if (ring == nullptr || size > ring->capacity / 2)
+    return nullptr;
+
+  uint64_t w = ring->writePos.load(std::memory_order_relaxed);
+  size_t index = static_cast<size_t>(w & ring->mask);
+  size_t contiguous = ring->capacity - index;
+  size_t need = contiguous < size ? contiguous + size : size;
+
+  if (w + need - ring->cachedReadPos > ring->capacity) {
+    ring->cachedReadPos = ring->readPos.load(std::memory_order_acquire);
+    if (w + need - ring->cachedReadPos > ring->capacity) {
+      ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+      return nullptr;
+    }
+  }
+
+  if (contiguous < size) { // 填充到末尾，记录从头开始
+    uint32_t padSize = static_cast<uint32_t>(contiguous);
+    memcpy(ring->data + index, &padSize, 4);
+    memcpy(ring->data + index + 4, &kPadding, 4);
+    // 和 commit 一样 release，后台线程 acquire writePos 之后能读到填充记录
+    ring->writePos.store(w + contiguous, std::memory_order_release);
+    index = 0;
+  }
+  return ring->data + index;
+}
+
+void BinaryLogging::commit(size_t size) {
+  ThreadRing *ring = t_ring;
+  ring->writePos.store(ring->writePos.load(std::memory_order_relaxed) + size,
+                       std::memory_order_release);
+}
+
+char *BinaryLogging::writeHeader(char *p, size_t size, int fmtId) {
+  uint32_t size32 = static_cast<uint32_t>(size);
+  uint32_t id = static_cast<uint32_t>(fmtId);
+  int64_t now = Timestamp::cachedNow().microSecondsSinceEpoch();
+  memcpy(p, &size32, 4);
+  memcpy(p + 4, &id, 4);
+  memcpy(p + 8, &now, 8);
+  return p + kHeaderSize;
+}
+
+namespace {
+
+const char *const kLevelNames[] = {"[DEBUG]", "[INFO]", "[ERROR]", "[FATAL]"};
+
+// 用 printf 风格的 spec 格式化一个参数，追加到 out
+template <typename T> void appendf(std::string *out, const char *spec, T v) {
+  char buf[128];
+  int n = snprintf(buf, sizeof buf, spec, v);
+  if (n < 0)
+    return;
+  if (static_cast<size_t>(n) < sizeof buf) {
+    out->append(buf, n);
+    return;
+  }
+  std::vector<char> big(n + 1);
+  snprintf(big.data(), big.size(), spec, v);
+  out->append(big.data(), n);
+}
+
+/* 按格式串还原一条日志
+ * 参数在记录中带有类型标签，长度修饰符以标签为准(整数统一按 long long 输出)
+ * 不支持 '*' 宽度和精度 */
+void formatMessage(const std::string &fmt, const char *args, const char *end,
+                   std::string *out) {
+  for (size_t i = 0; i < fmt.size(); ++i) {
+    char c = fmt[i];
+    if (c != '%') {
+      out->push_back(c);
+      continue;
+    }
+    if (i + 1 < fmt.size() && fmt[i + 1] == '%') {
+      out->push_back('%');
+      ++i;
+      continue;
+    }
+
+    std::string spec = "%";
+    size_t j = i + 1;
+    while (j < fmt.size() && strchr("-+ #0", fmt[j]) != nullptr)
+      spec += fmt[j++];
+    while (j < fmt.size() && (isdigit(fmt[j]) || fmt[j] == '.'))
+      spec += fmt[j++];
+    while (j < fmt.size() && strchr("hlLqjzt", fmt[j]) != nullptr)
+      ++j; // 丢弃长度修饰符
+    if (j >= fmt.size())
+      break;
+    const char conv = fmt[j];
+    i = j;
+
+    if (args >= end) {
+      out->append("<missing>");
+      continue;
+    }
+    const uint8_t tag = static_cast<uint8_t>(*args++);
+    std::string str;
+    uint64_t bits = 0;
+    if (tag == BinaryLogging::kString) {
+      uint16_t len = 0;
+      if (end - args < 2)
+        break;
+      memcpy(&len, args, 2);
+      args += 2;
+      if (end - args < len)
+        break;
+      str.assign(args, len);
+      args += len;
+    } else {
+      if (end - args < 8)
+        break;
+      memcpy(&bits, args, 8);
+      args += 8;
+    }
+
+    double d = 0.0;
+    if (tag == BinaryLogging::kDouble)
+      memcpy(&d, &bits, 8);
+    else if (tag == BinaryLogging::kInt)
+      d = static_cast<double>(static_cast<int64_t>(bits));
+    else
+      d = static_cast<double>(bits);
+    if (tag == BinaryLogging::kDouble) // 浮点数按整数输出时截断
+      bits = static_cast<uint64_t>(static_cast<int64_t>(d));
+
+    switch (conv) {
+    case 'd':
+    case 'i':
+      appendf(out, (spec + "ll" + conv).c_str(),
+              static_cast<long long>(bits));
+      break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+      appendf(out, (spec + "ll" + conv).c_str(),
+              static_cast<unsigned long long>(bits));
+      break;
+    case 'c':
+      appendf(out, (spec + conv).c_str(), static_cast<int>(bits));
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      appendf(out, (spec + conv).c_str(), d);
+      break;
+    case 'p':
+      appendf(out, (spec + conv).c_str(),
+              reinterpret_cast<void *>(static_cast<uintptr_t>(bits)));
+      break;
+    case 's':
+      if (tag == BinaryLogging::kString)
+        appendf(out, (spec + conv).c_str(), str.c_str());
+      else
+        out->append("<?>");
+      break;
+    default:
+      out->append(spec).push_back(conv);
+      break;
+    }
+  }
+}
+
+template <typename T> bool readValue(const char **p, const char *end, T *v) {
+  if (static_cast<size_t>(end - *p) < sizeof(T))
+    return false;
+  memcpy(v, *p, sizeof(T));
+  *p += sizeof(T);
+  return true;
+}
+
+} // namespace
+
+bool BinaryLogging::decode(const std::string &path, FILE *out) {
+  FILE *in = fopen(path.c_str(), "re");
+  if (in == nullptr)
+    return false;
+  std::string content;
+  char buf[64 * 1024];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof buf, in)) > 0)
+    content.append(buf, n);
+  fclose(in);
+
+  if (content.size() < sizeof kMagic ||
+      memcmp(content.data(), kMagic, sizeof kMagic) != 0)
+    return false;
+
+  std::unordered_map<uint32_t, FormatInfo> formats;
+  const char *p = content.data() + sizeof kMagic;
+  const char *end = content.data() + content.size();
+  std::string line;
+  while (p < end) {
+    const char type = *p++;
+    if (type == 'F') {
+      uint32_t id, lineNo;
+      uint8_t level;
+      uint16_t fileLen, fmtLen;
+      FormatInfo info;
+      if (!readValue(&p, end, &id) || !readValue(&p, end, &level) ||
+          !readValue(&p, end, &lineNo) || !readValue(&p, end, &fileLen) ||
+          end - p < fileLen)
+        return false;
+      info.file.assign(p, fileLen);
+      p += fileLen;
+      if (!readValue(&p, end, &fmtLen) || end - p < fmtLen)
+        return false;
+      info.fmt.assign(p, fmtLen);
+      p += fmtLen;
+      info.level = level < 4 ? level : 0;
+      info.line = static_cast<int>(lineNo);
+      formats[id] = std::move(info);
+    } else if (type == 'L') {
+      uint32_t tid, size, fmtId;
+      int64_t micros;
+      const char *record = p + 4;
+      if (!readValue(&p, end, &tid) || !readValue(&p, end, &size) ||
+          !readValue(&p, end, &fmtId) || !readValue(&p, end, &micros) ||
+          size < kHeaderSize || static_cast<size_t>(end - record) < size)
+        return false;
+      p = record + size;
+
+      auto it = formats.find(fmtId);
+      if (it == formats.end())
+        return false;
+      line.clear();
+      line += kLevelNames[it->second.level];
+      line += Timestamp(micros).toString();
+      line += " : ";
+      formatMessage(it->second.fmt, record + kHeaderSize, record + size,
+                    &line);
+      line += '\n';
+      fwrite(line.data(), 1, line.size(), out);
+    } else
+      return false;
+  }
+  return true;
+}
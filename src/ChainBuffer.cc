@@ -0,0 +1,112 @@
+#include "ChainBuffer.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <new>
+#include <string.h>
+#include <sys/uio.h>
+
+ChainBuffer::ChainBuffer()
+    : pool_(nullptr), head_(nullptr), tail_(nullptr), readable_(0),
+      slabCount_(0) {}
+
+ChainBuffer::~ChainBuffer() { retrieveAll(); }
+
+void ChainBuffer::append(const void *data, size_t len) {
+  const char *p = static_cast<const char *>(data);
+  while (len > 0) {
+    if (tail_ == nullptr || tail_->writeIndex == kSlabSize) {
+      Slab *slab = allocSlab();
+      if (tail_ == nullptr)
+        head_ = slab;
+      else
+        tail_->next = slab;
+      tail_ = slab;
+    }
+    size_t n = std::min(len, kSlabSize - tail_->writeIndex);
+    memcpy(tail_->data + tail_->writeIndex, p, n);
+    tail_->writeIndex += n;
+    readable_ += n;
+    p += n;
+    len -= n;
+  }
+}
+
+void ChainBuffer::retrieve(size_t len) {
+  if (len >= readable_) {
+    retrieveAll();
+    return;
+  }
+
+  readable_ -= len;
+  while (len > 0) {
+    size_t n = std::min(len, head_->writeIndex - head_->readIndex);
+    head_->readIndex += n;
+    len -= n;
+    // 读空并且已经写满的 slab 不会再被使用；尾部的 slab 留着继续写
+    if (head_->readIndex == kSlabSize) {
+      Slab *next = head_->next;
+      freeSlab(head_);
+      head_ = next;
+    }
+  }
+}
+
+void ChainBuffer::retrieveAll() {
+  while (head_ != nullptr) {
+    Slab *next = head_->next;
+    freeSlab(head_);
+    head_ = next;
+  }
+  tail_ = nullptr;
+  readable_ = 0;
+}
+
+ssize_t ChainBuffer::writeFd(int fd, int *saveErrno, size_t maxBytes) {
+  struct iovec vec[kMaxIovecs];
+  int iovcnt =
+      peekIovecs(vec, kMaxIovecs, 0, std::min(maxBytes, readable_));
+  ssize_t n = ::writev(fd, vec, iovcnt);
+  if (n < 0)
+    *saveErrno = errno;
+  return n;
+}
+
+int ChainBuffer::peekIovecs(struct iovec *vec, int maxIovecs, size_t offset,
+                            size_t len) const {
+  int iovcnt = 0;
+  for (Slab *slab = head_; slab != nullptr && iovcnt < maxIovecs && len > 0;
+       slab = slab->next) {
+    size_t n = slab->writeIndex - slab->readIndex;
+    if (offset >= n) { // 跳过 offset 之前的 slab
+      offset -= n;
+      continue;
+    }
+    n = std::min(n - offset, len);
+    vec[iovcnt].iov_base = slab->data + slab->readIndex + offset;
+    vec[iovcnt].iov_len = n;
+    offset = 0;
+    len -= n;
+    ++iovcnt;
+  }
+  return iovcnt;
+}
+
+ChainBuffer::Slab *ChainBuffer::allocSlab() {
+  void *block = pool_ != nullptr ? pool_->allocate()
+                                 : ::operator new(SlabPool::kBlockSize);
+  Slab *slab = static_cast<Slab *>(block);
+  slab->next = nullptr;
+  slab->readIndex = 0;
+  slab->writeIndex = 0;
+  ++slabCount_;
+  return slab;
+}
+
+void ChainBuffer::freeSlab(Slab *slab) {
+  --slabCount_;
+  if (pool_ != nullptr)
+    pool_->deallocate(slab);
+  else
+    ::operator delete(slab);
+}
@@ -11,7 +11,8 @@ const int Channel::kWriteEvent = EPOLLOUT;
 
 // 1 个 EventLoop 对应 1 个 Poller，1 个 Poller 对应多个 Channel，即 ChannelList
 Channel::Channel(EventLoop *loop, int fd)
-    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false) {}
+    : loop_(loop), fd_(fd), events_(0), revents_(0), edgeTriggered_(false),
+      tied_(false) {}
 
 Channel::~Channel() {}
 
@@ -54,7 +55,7 @@ void Channel::handleEvent(Timestamp receiveTime) {
 // 接收一个时间戳参数，表示事件发生的时间
 void Channel::handleEventWithGuard(Timestamp receiveTime) {
   // 记录日志，显示当前处理的事件类型
-  LOG_INFO("channel handleEvent revents:%d\n", revents_);
+  LOG_DEBUG("channel handleEvent revents:%d\n", revents_);
 
   // 事件类型为 EPOLLHUP（挂起）且不 EPOLLIN（可读）
   // 这通常表示连接已经关闭或者出现了某种错误
@@ -1,11 +1,23 @@
 #include "EPollPoller.h"
+#include "IoUringPoller.h"
+#include "Logger.h"
 #include "Poller.h"
 
 #include <stdlib.h>
 
 /* 静态成员函数，根据环境变量决定使用的 Poller 实例
  * 默认使用 EPollPoller，即 epoll
+ * 设置了 MUDUO_USE_IOURING 时使用 IoUringPoller，不可用时回退到 epoll
  */
 Poller *Poller::newDefaultPoller(EventLoop *loop) {
-  return ::getenv("MUDUO_USE_POLL") ? nullptr : new EPollPoller(loop);
-}
\ No newline at end of file
+  if (::getenv("MUDUO_USE_POLL"))
+    return nullptr;
+  if (::getenv("MUDUO_USE_IOURING")) {
+    IoUringPoller *poller = new IoUringPoller(loop);
+    if (poller->valid())
+      return poller;
+    delete poller;
+    LOG_ERROR("io_uring unavailable, fall back to epoll \n");
+  }
+  return new EPollPoller(loop);
+}
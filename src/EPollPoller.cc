@@ -2,10 +2,24 @@
 #include "Channel.h"
 #include "Logger.h"
 
+#include <assert.h>
 #include <errno.h>
+#include <stdint.h>
 #include <strings.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
 
+// Linux 6.9 新增的 epoll busy poll ioctl，旧版本的 glibc 头文件中没有定义
+#ifndef EPIOCSPARAMS
+struct epoll_params {
+  uint32_t busy_poll_usecs;
+  uint16_t busy_poll_budget;
+  uint8_t prefer_busy_poll;
+  uint8_t __pad; // must be zero
+};
+#define EPIOCSPARAMS _IOW(0x8A, 0x01, struct epoll_params)
+#endif
+
 // 对应于 channel 的 index_ 成员
 const int kNew = -1;    // channel 未添加到 EPollPoller 中，初始值
 const int kAdded = 1;   // channel 已添加到 EPollPoller 中
@@ -34,7 +48,9 @@ EPollPoller::~EPollPoller() { ::close(epollfd_); }
  */
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels) {
   // 当前管理的文件描述符总数
-  LOG_INFO("func=%s => fd total count:%lu \n", __FUNCTION__, channels_.size());
+  LOG_DEBUG("func=%s => fd total count:%lu \n", __FUNCTION__, numChannels_);
+
+  syncDirtyChannels(); // 等待之前把本轮累积的修改一次性提交给内核
 
   // 调用 epoll_wait 函数监听事件，将事件存放在 events_ 数组中
   int numEvents = ::epoll_wait(epollfd_, &*events_.begin(),
@@ -43,7 +59,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels) {
   Timestamp now(Timestamp::now());
 
   if (numEvents > 0) {
-    LOG_INFO("%d events happened \n", numEvents);  // 发生的事件数量
+    LOG_DEBUG("%d events happened \n", numEvents); // 发生的事件数量
     fillActiveChannels(numEvents, activeChannels); // 填充活跃通道列表
     if (numEvents == events_.size()) // 如果 events_ 数组不够大，扩展数组大小
       events_.resize(events_.size() * 2);
@@ -60,42 +76,82 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels) {
 /*
  * 1. 更改 channel 的状态
  * 2. 将 channel 添加到 channels_ 中，也就是当前的 EPollPoller 对象中
- * 3. 调用封装的 update() 方法，添加、修改、删除 channel 所关注的事件
+ * 3. 把 fd 标记为 dirty，由 syncDirtyChannels() 在下一次 poll() 之前
+ *    添加、修改、删除 channel 所关注的事件
  */
 void EPollPoller::updateChannel(Channel *channel) {
-  const int index = channel->index(); // 获取 channel 当前的状态索引
-  LOG_INFO("func=%s => fd=%d events=%d index=%d \n", __FUNCTION__,
-           channel->fd(), channel->events(), index);
+  ChannelSlot &slot = slotOf(channel->fd()); // 获取 fd 对应的 slot
+  const int index = slot.channel == nullptr ? kNew : slot.index;
+  LOG_DEBUG("func=%s => fd=%d events=%d index=%d \n", __FUNCTION__,
+            channel->fd(), channel->events(), index);
 
   if (index == kNew || index == kDeleted) {
     if (index == kNew) { // a new one, add with EPOLL_CTL_ADD
-      int fd = channel->fd();
-      channels_[fd] = channel; // 将 channel 添加到 channels_ 中，也就是添加到
-                               // EPollPoller 中
+      slot.channel = channel; // 将 channel 添加到 channels_ 中，也就是添加到
+                              // EPollPoller 中
+      ++numChannels_;
     }
+    assert(slot.channel == channel); // fd 属于当前 loop 的这个 channel
+
+    slot.index = kAdded; // 设置 channel 状态为 kAdded
+  } else { // update existing one with EPOLL_CTL_MOD/DEL
+    assert(slot.channel == channel);
+    if (channel->isNoneEvent())
+      slot.index = kDeleted;
+  }
 
-    channel->set_index(kAdded); // 设置 channel 状态为 kAdded
-    update(EPOLL_CTL_ADD, channel);
-  } else // update existing one with EPOLL_CTL_MOD/DEL
-    if (channel->isNoneEvent()) {
-      update(EPOLL_CTL_DEL, channel);
-      channel->set_index(kDeleted);
-    } else
-      update(EPOLL_CTL_MOD, channel);
+  if (!slot.dirty) { // 每个 fd 在 dirtyFds_ 中至多出现一次
+    slot.dirty = true;
+    dirtyFds_.push_back(channel->fd());
+  }
 }
 
 // 从 EPollPoller 中删除 channel
 void EPollPoller::removeChannel(Channel *channel) {
-  int fd = channel->fd();
-  channels_.erase(
-      fd); // 从 channels_ 中删除 channel，也就是从 EPollPoller 中删除
+  const int fd = channel->fd();
+  assert(hasChannel(channel)); // fd 属于当前 loop 的这个 channel
+  ChannelSlot &slot = channels_[fd];
 
   LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
 
-  int index = channel->index();
-  if (index == kAdded)
-    update(EPOLL_CTL_DEL, channel);
-  channel->set_index(kNew); // 设置 channel 状态为 kNew
+  if (slot.events != 0) // 内核中已注册，fd 关闭之前必须立即删除
+    update(EPOLL_CTL_DEL, channel, 0);
+  /* 从 channels_ 中删除 channel，也就是从 EPollPoller 中删除
+   * slot.dirty 保持不变，fd 可能还在 dirtyFds_ 中，同步时会跳过 */
+  slot.channel = nullptr;
+  slot.index = kNew; // 设置 channel 状态为 kNew
+  slot.events = 0;
+  --numChannels_;
+}
+
+/* 比较 channel 当前关注的事件和内核中注册的事件：
+ * 未注册 => ADD，不再关注 => DEL，不同 => MOD，相同 => 跳过 */
+void EPollPoller::syncDirtyChannels() {
+  for (int fd : dirtyFds_) {
+    ChannelSlot &slot = channels_[fd];
+    slot.dirty = false;
+    if (slot.channel == nullptr) // 标记之后已经被 removeChannel
+      continue;
+
+    Channel *channel = slot.channel;
+    uint32_t events = 0;
+    if (slot.index == kAdded && !channel->isNoneEvent()) {
+      events = channel->events();
+      if (channel->isEdgeTriggered()) // 边缘触发模式
+        events |= EPOLLET;
+    }
+
+    if (events == slot.events)
+      continue; // 本轮的修改相互抵消了
+    if (slot.events == 0)
+      update(EPOLL_CTL_ADD, channel, events);
+    else if (events == 0)
+      update(EPOLL_CTL_DEL, channel, 0);
+    else
+      update(EPOLL_CTL_MOD, channel, events);
+    slot.events = events;
+  }
+  dirtyFds_.clear();
 }
 
 void EPollPoller::fillActiveChannels(int numEvents,
@@ -112,13 +168,13 @@ void EPollPoller::fillActiveChannels(int numEvents,
 }
 
 // epoll_ctl() 操作，同时让 event.data.ptr 指向对应的 channel
-void EPollPoller::update(int operation, Channel *channel) {
+void EPollPoller::update(int operation, Channel *channel, uint32_t events) {
   epoll_event event;
   bzero(&event, sizeof event);
 
   int fd = channel->fd();
 
-  event.events = channel->events();
+  event.events = events;
   event.data.fd = fd; // 无所谓，源码中并没有使用
   event.data.ptr = channel;
 
@@ -127,4 +183,20 @@ void EPollPoller::update(int operation, Channel *channel) {
       LOG_ERROR("epoll_ctl del error:%d\n", errno);
     else
       LOG_FATAL("epoll_ctl add/mod error:%d\n", errno);
-}
\ No newline at end of file
+}
+
+// 内核不支持(ENOTTY)或者参数超出限制时返回 false，epoll 仍然可以正常使用
+bool EPollPoller::setBusyPoll(int usecs, int budget) {
+  epoll_params params;
+  bzero(&params, sizeof params);
+  params.busy_poll_usecs = static_cast<uint32_t>(usecs);
+  params.busy_poll_budget = static_cast<uint16_t>(budget);
+  params.prefer_busy_poll = usecs > 0 ? 1 : 0;
+
+  if (::ioctl(epollfd_, EPIOCSPARAMS, &params) < 0) {
+    LOG_ERROR("EPollPoller::setBusyPoll usecs=%d budget=%d error:%d \n", usecs,
+              budget, errno);
+    return false;
+  }
+  return true;
+}
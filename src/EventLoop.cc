@@ -2,6 +2,9 @@
 #include "Channel.h"
 #include "Logger.h"
 #include "Poller.h"
+#include "SlabPool.h"
+#include "TimerQueue.h"
+#include "TimingWheel.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -15,6 +18,13 @@ __thread EventLoop *t_loopInThisThread = nullptr;
 // 定义默认的 Poller I/O 复用接口的超时时间
 const int kPollTimeMs = 10000;
 
+// 时间轮每秒一个 tick，一圈 64 个槽位，更长的超时由时间轮重新挂入处理
+const double kTimingWheelTickSeconds = 1.0;
+const size_t kTimingWheelBuckets = 64;
+
+// 每 10 秒回收一次 SlabPool 中一直空闲的 block
+const double kSlabPoolTrimSeconds = 10.0;
+
 // 创建一个 eventfd 文件描述符，用于线程间通信
 int createEventfd() {
   // 初始计数值为 0，并设置为 nonblock 和 close-on-exec
@@ -26,7 +36,9 @@ int createEventfd() {
 
 EventLoop::EventLoop()
     : looping_(false), quit_(false), callingPendingFunctors_(false),
-      threadId_(CurrentThread::tid()), poller_(Poller::newDefaultPoller(this)),
+      wakeupPending_(false), threadId_(CurrentThread::tid()),
+      poller_(Poller::newDefaultPoller(this)),
+      timerQueue_(new TimerQueue(this)), spinPolls_(0),
       wakeupFd_(createEventfd()), wakeupChannel_(new Channel(this, wakeupFd_)) {
   LOG_DEBUG("EventLoop created %p in thread %d \n", this, threadId_);
   if (t_loopInThisThread)
@@ -56,20 +68,45 @@ void EventLoop::loop() {
 
   LOG_INFO("EventLoop %p start looping \n", this);
 
+  int idleSpins = 0; // 连续没有轮询到事件的 0 超时轮询次数
   while (!quit_) {
     // 清空 activeChannels_，准备存放本次事件循环中活跃的通道
     activeChannels_.clear();
 
+    // 自旋预算没有用完时不阻塞，避免 epoll_wait 睡眠和唤醒的开销
+    const bool spinning = idleSpins < spinPolls_;
+
     // epoll_ctl() 操作，并获取发生事件的时间戳和 activeChannels_
-    pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+    const int64_t pollStart = EventLoopMetrics::nowMicros();
+    pollReturnTime_ =
+        poller_->poll(spinning ? 0 : kPollTimeMs, &activeChannels_);
+    const int64_t pollEnd = EventLoopMetrics::nowMicros();
+    Timestamp::setCachedNow(pollReturnTime_);
+
+    metrics_.addIteration();
+    metrics_.pollUs.record(pollEnd - pollStart);
+    metrics_.eventsPerPoll.record(activeChannels_.size());
+    if (spinning) {
+      metrics_.addSpinPoll(!activeChannels_.empty());
+      idleSpins = activeChannels_.empty() ? idleSpins + 1 : 0;
+    } else {
+      metrics_.addBlockingPoll();
+      idleSpins = 0; // 阻塞等待返回后重新开始自旋
+    }
 
-    for (Channel *channel : activeChannels_)
-      channel->handleEvent(pollReturnTime_);
+    if (!activeChannels_.empty()) {
+      for (Channel *channel : activeChannels_)
+        channel->handleEvent(pollReturnTime_);
+      metrics_.dispatchUs.record(EventLoopMetrics::nowMicros() - pollEnd);
+    }
+    // 发送本轮事件处理中 cork 住的数据
+    doFlushes();
 
     // 执行当前 EventLoop 需要处理的延迟回调
     doPendingFunctors();
   }
 
+  Timestamp::setCachedNow(Timestamp::invalid());
   LOG_INFO("EventLoop %p stop looping. \n", this);
   looping_ = false;
 }
@@ -89,15 +126,15 @@ void EventLoop::quit() {
 /* 1. 如果调用 runInLoop() 和 EventLoop 在同一个线程，直接执行 cb
  * 2. 如果调用 runInLoop() 和 EventLoop 不在同一个线程，调用 queueInLoop() */
 void EventLoop::runInLoop(Functor cb) {
-  isInLoopThread() ? cb() : queueInLoop(cb);
+  isInLoopThread() ? cb() : queueInLoop(std::move(cb));
 }
 
 // 把 cb 放入 pendingFunctors_，唤醒 loop 所在的线程，执行 cb
 void EventLoop::queueInLoop(Functor cb) {
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    pendingFunctors_.emplace_back(cb);
-  }
+  if (isInLoopThread()) // loop 线程自己提交的回调不经过无锁队列
+    localFunctors_.push_back(std::move(cb));
+  else
+    pendingFunctors_.push(std::move(cb)); // 无锁入队
 
   /* 1. 如果调用 queueInLoop() 和 EventLoop 不在同一个线程，或者
    *    callingPendingFunctors_ 为 true 时（此时正在执行
@@ -105,15 +142,59 @@ void EventLoop::queueInLoop(Functor cb) {
    * 2. 如果调用 queueInLoop() 和 EventLoop 在同一个线程，但是
    *    callingPendingFunctors_ 为 false 时，则说明：此时尚未执行到
    *    doPendingFunctors()。
-   *    不必唤醒，这个优雅的设计可以减少对 eventfd 的 I/O 读写 */
-  if (!isInLoopThread() || callingPendingFunctors_)
+   *    不必唤醒，这个优雅的设计可以减少对 eventfd 的 I/O 读写
+   * 3. loop 开始处理回调之前，只有第一个把 wakeupPending_ 置为 true 的
+   *    生产者写 eventfd，其余的生产者合并到这一次唤醒中 */
+  if ((!isInLoopThread() || callingPendingFunctors_) &&
+      !wakeupPending_.exchange(true, std::memory_order_acq_rel))
     wakeup();
 }
 
+void EventLoop::queueFlush(Functor cb) {
+  flushFunctors_.push_back(std::move(cb));
+}
+
+bool EventLoop::setKernelBusyPoll(int usecs, int budget) {
+  return poller_->setBusyPoll(usecs, budget);
+}
+
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb) {
+  return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb) {
+  Timestamp time(addTime(Timestamp::now(), delay));
+  return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb) {
+  Timestamp time(addTime(Timestamp::now(), interval));
+  return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId) { return timerQueue_->cancel(timerId); }
+
+TimingWheel *EventLoop::timingWheel() {
+  if (!timingWheel_)
+    timingWheel_.reset(new TimingWheel(this, kTimingWheelTickSeconds,
+                                       kTimingWheelBuckets));
+  return timingWheel_.get();
+}
+
+SlabPool *EventLoop::slabPool() {
+  if (!slabPool_) {
+    slabPool_.reset(new SlabPool);
+    runEvery(kSlabPoolTrimSeconds,
+             std::bind(&SlabPool::trim, slabPool_.get()));
+  }
+  return slabPool_.get();
+}
+
 // 参见 man eventfd 中和 read 结合的 example
 void EventLoop::handleRead() {
   uint64_t one = 1;
   ssize_t n = read(wakeupFd_, &one, sizeof one);
+  metrics_.addWakeupHandled();
 
   if (n != sizeof one)
     LOG_ERROR("EventLoop::handleRead() reads %lu bytes instead of 8", n);
@@ -124,6 +205,7 @@ void EventLoop::handleRead() {
 void EventLoop::wakeup() {
   uint64_t one = 1;
   ssize_t n = write(wakeupFd_, &one, sizeof one);
+  metrics_.addWakeupSent();
   if (n != sizeof one)
     LOG_ERROR("EventLoop::wakeup() writes %lu bytes instead of 8 \n", n);
 }
@@ -140,17 +222,38 @@ bool EventLoop::hasChannel(Channel *channel) {
   return poller_->hasChannel(channel);
 }
 
+/* 1. 先清除 wakeupPending_ 再出队，清除之后入队的回调一定会重新唤醒 loop
+ * 2. 只执行本轮开始时已经入队的回调，回调中再次入队的留到下一轮，
+ *    避免回调不断入队导致 loop 无法返回 poll */
 void EventLoop::doPendingFunctors() {
-  std::vector<Functor> functors;
   callingPendingFunctors_ = true;
+  wakeupPending_.exchange(false, std::memory_order_acq_rel);
 
-  { // 通过 swap 减小临界区长度
-    std::unique_lock<std::mutex> lock(mutex_);
-    functors.swap(pendingFunctors_);
-  }
+  functors_.swap(localFunctors_);
+  Functor functor;
+  while (pendingFunctors_.pop(&functor))
+    functors_.push_back(std::move(functor));
 
-  for (const Functor &functor : functors)
-    functor(); // 执行当前 loop 需要执行的回调操作
+  if (!functors_.empty()) {
+    const int64_t start = EventLoopMetrics::nowMicros();
+    for (const Functor &f : functors_)
+      f(); // 执行当前 loop 需要执行的回调操作
+    metrics_.functorDepth.record(functors_.size());
+    metrics_.functorUs.record(EventLoopMetrics::nowMicros() - start);
+    functors_.clear();
+  }
 
+  /* 回调中 send 的数据也在 poll 之前发出；这时 callingPendingFunctors_
+   * 还是 true，flush 中 queueInLoop 的回调(writeComplete)会唤醒下一轮 */
+  doFlushes();
   callingPendingFunctors_ = false;
+}
+
+void EventLoop::doFlushes() {
+  if (flushFunctors_.empty())
+    return;
+  flushing_.swap(flushFunctors_);
+  for (const Functor &f : flushing_)
+    f();
+  flushing_.clear();
 }
\ No newline at end of file
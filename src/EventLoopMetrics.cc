@@ -0,0 +1,76 @@
+#include "EventLoopMetrics.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <time.h>
+
+Histogram::Histogram() : count_(0), sum_(0), max_(0) {
+  for (int i = 0; i < kBuckets; ++i)
+    buckets_[i].store(0, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+  Snapshot snap;
+  snap.count = count_.load(std::memory_order_relaxed);
+  snap.sum = sum_.load(std::memory_order_relaxed);
+  snap.max = max_.load(std::memory_order_relaxed);
+  for (int i = 0; i < kBuckets; ++i)
+    snap.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+  return snap;
+}
+
+uint64_t Histogram::Snapshot::percentile(double p) const {
+  if (count == 0)
+    return 0;
+  uint64_t target = static_cast<uint64_t>(p * count);
+  if (target >= count)
+    target = count - 1;
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += buckets[i];
+    if (seen > target) // 第 i 个桶的上界是 2^i - 1，不超过 max
+      return i == 0 ? 0 : std::min<uint64_t>((1ULL << i) - 1, max);
+  }
+  return max;
+}
+
+EventLoopMetrics::EventLoopMetrics()
+    : iterations_(0), wakeupsSent_(0), wakeupsHandled_(0), spinPolls_(0),
+      spinHits_(0), blockingPolls_(0) {}
+
+int64_t EventLoopMetrics::nowMicros() {
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 + ts.tv_nsec / 1000;
+}
+
+EventLoopMetrics::Snapshot EventLoopMetrics::snapshot() const {
+  Snapshot snap;
+  snap.iterations = iterations_.load(std::memory_order_relaxed);
+  snap.wakeupsSent = wakeupsSent_.load(std::memory_order_relaxed);
+  snap.wakeupsHandled = wakeupsHandled_.load(std::memory_order_relaxed);
+  snap.spinPolls = spinPolls_.load(std::memory_order_relaxed);
+  snap.spinHits = spinHits_.load(std::memory_order_relaxed);
+  snap.blockingPolls = blockingPolls_.load(std::memory_order_relaxed);
+  snap.pollUs = pollUs.snapshot();
+  snap.eventsPerPoll = eventsPerPoll.snapshot();
+  snap.dispatchUs = dispatchUs.snapshot();
+  snap.functorDepth = functorDepth.snapshot();
+  snap.functorUs = functorUs.snapshot();
+  return snap;
+}
+
+std::string EventLoopMetrics::Snapshot::toString() const {
+  char buf[512];
+  snprintf(buf, sizeof buf,
+           "iterations=%lu wakeups=%lu/%lu spin=%lu/%lu blocking=%lu "
+           "poll_us(mean=%.1f p99=%lu) events(mean=%.1f max=%lu) "
+           "dispatch_us(mean=%.1f p99=%lu) functors(mean=%.1f max=%lu) "
+           "functor_us(mean=%.1f p99=%lu)",
+           iterations, wakeupsHandled, wakeupsSent, spinHits, spinPolls,
+           blockingPolls, pollUs.mean(), pollUs.percentile(0.99),
+           eventsPerPoll.mean(), eventsPerPoll.max, dispatchUs.mean(),
+           dispatchUs.percentile(0.99), functorDepth.mean(), functorDepth.max,
+           functorUs.mean(), functorUs.percentile(0.99));
+  return buf;
+}
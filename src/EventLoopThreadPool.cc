@@ -1,4 +1,5 @@
 #include "EventLoopThreadPool.h"
+#include "EventLoop.h"
 #include "EventLoopThread.h"
 
 #include <memory>
@@ -46,4 +47,11 @@ EventLoop *EventLoopThreadPool::getNextLoop() {
 
 std::vector<EventLoop *> EventLoopThreadPool::getAllLoops() {
   return loops_.empty() ? std::vector<EventLoop *>(1, baseLoop_) : loops_;
-}
\ No newline at end of file
+}
+
+std::vector<EventLoopMetrics::Snapshot> EventLoopThreadPool::metrics() {
+  std::vector<EventLoopMetrics::Snapshot> snapshots;
+  for (EventLoop *loop : getAllLoops())
+    snapshots.push_back(loop->metrics());
+  return snapshots;
+}
@@ -0,0 +1,322 @@
+#include "IoUringPoller.h"
+#include "Channel.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// 对应于 ChannelSlot 的 index 成员
+const int kNew = -1;  // channel 未添加到 IoUringPoller 中，初始值
+const int kAdded = 1; // channel 已添加到 IoUringPoller 中
+
+// POLL_REMOVE 请求自身的完成事件使用该 user_data，收割时直接忽略
+const uint64_t kIgnoreUserData = ~0ULL;
+
+static int io_uring_setup(unsigned entries, io_uring_params *p) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete,
+                          unsigned flags, void *arg, size_t argsz) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit,
+                                    minComplete, flags, arg, argsz));
+}
+
+// user_data 的高 32 位保存 fd，低 32 位保存 poll 请求的序号
+static uint64_t encodeUserData(int fd, uint32_t gen) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(fd)) << 32) | gen;
+}
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop), ringFd_(-1), sqRing_(MAP_FAILED), sqRingSize_(0),
+      sqHead_(nullptr), sqTail_(nullptr), sqMask_(nullptr), sqArray_(nullptr),
+      sqEntries_(0), sqes_(nullptr), sqesSize_(0), toSubmit_(0),
+      cqRing_(MAP_FAILED), cqRingSize_(0), cqHead_(nullptr), cqTail_(nullptr),
+      cqMask_(nullptr), cqes_(nullptr), nextGen_(0) {
+  if (!setupRing())
+    teardownRing();
+}
+
+IoUringPoller::~IoUringPoller() { teardownRing(); }
+
+/*
+ * 1. io_uring_setup() 创建 io_uring 实例
+ * 2. mmap 映射 SQ ring、CQ ring 和 SQE 数组
+ * 3. 要求内核支持 IORING_FEAT_EXT_ARG(5.11+)，以便 io_uring_enter
+ *    可以直接带超时等待，不需要额外提交 IORING_OP_TIMEOUT
+ */
+bool IoUringPoller::setupRing() {
+  io_uring_params params;
+  memset(&params, 0, sizeof params);
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = kRingEntries * 4;
+
+  ringFd_ = io_uring_setup(kRingEntries, &params);
+  if (ringFd_ < 0) {
+    LOG_ERROR("io_uring_setup error:%d \n", errno);
+    return false;
+  }
+  if (!(params.features & IORING_FEAT_EXT_ARG) ||
+      !(params.features & IORING_FEAT_NODROP)) {
+    LOG_ERROR("io_uring features:%u not supported \n", params.features);
+    return false;
+  }
+
+  sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (singleMmap)
+    sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+  sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+  if (sqRing_ == MAP_FAILED) {
+    LOG_ERROR("io_uring mmap sq ring error:%d \n", errno);
+    return false;
+  }
+  if (singleMmap)
+    cqRing_ = sqRing_;
+  else {
+    cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+    if (cqRing_ == MAP_FAILED) {
+      LOG_ERROR("io_uring mmap cq ring error:%d \n", errno);
+      return false;
+    }
+  }
+
+  sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+  void *sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    LOG_ERROR("io_uring mmap sqes error:%d \n", errno);
+    return false;
+  }
+  sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+  char *sq = static_cast<char *>(sqRing_);
+  sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sqMask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  sqEntries_ = params.sq_entries;
+
+  char *cq = static_cast<char *>(cqRing_);
+  cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cqMask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  return true;
+}
+
+void IoUringPoller::teardownRing() {
+  if (sqes_ != nullptr)
+    ::munmap(sqes_, sqesSize_);
+  if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+    ::munmap(cqRing_, cqRingSize_);
+  if (sqRing_ != MAP_FAILED)
+    ::munmap(sqRing_, sqRingSize_);
+  if (ringFd_ >= 0)
+    ::close(ringFd_);
+  sqes_ = nullptr;
+  sqRing_ = cqRing_ = MAP_FAILED;
+  ringFd_ = -1;
+}
+
+/*
+ * 1. 提交所有在 updateChannel/removeChannel/上一轮收割中积累的 SQE
+ * 2. 在同一次 io_uring_enter 中等待至少一个完成事件，或者超时
+ * 3. 收割 CQ，将发生事件的 channel 添加到 activeChannels 中，并设定其 revents
+ */
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList *activeChannels) {
+  LOG_DEBUG("func=%s => fd total count:%lu \n", __FUNCTION__, numChannels_);
+
+  // 为上一轮触发过的、或者关注事件发生变化的 channel 重新注册 poll 请求
+  for (int fd : dirtyFds_) {
+    PollState &state = states_[fd];
+    if (!state.dirty)
+      continue;
+    state.dirty = false;
+    Channel *channel = channels_[fd].channel;
+    if (channel != nullptr && !channel->isNoneEvent())
+      armPoll(fd, channel, &state);
+  }
+  dirtyFds_.clear();
+
+  // CQ 中已经有未收割的事件时，只提交不等待
+  const bool pending =
+      __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) != *cqHead_;
+  submit(pending ? 0 : 1, timeoutMs, !pending);
+  Timestamp now(Timestamp::now());
+
+  int numEvents = reapCompletions(activeChannels);
+  if (numEvents > 0)
+    LOG_DEBUG("%d events happened \n", numEvents); // 发生的事件数量
+  else if (numEvents == 0)
+    LOG_DEBUG("%s timeout! \n", __FUNCTION__);
+  return now;
+}
+
+/*
+ * 1. 新的 channel 添加到 channels_ 中
+ * 2. 如果关注的事件发生了变化，撤销在途的 poll 请求
+ * 3. 标记为 dirty，在下一次 poll() 时统一注册新的 poll 请求
+ */
+void IoUringPoller::updateChannel(Channel *channel) {
+  const int fd = channel->fd();
+  ChannelSlot &slot = slotOf(fd);
+  LOG_DEBUG("func=%s => fd=%d events=%d index=%d \n", __FUNCTION__, fd,
+            channel->events(), slot.channel == nullptr ? kNew : slot.index);
+
+  if (slot.channel == nullptr) {
+    slot.channel = channel;
+    slot.index = kAdded;
+    ++numChannels_;
+  }
+  assert(slot.channel == channel); // fd 属于当前 loop 的这个 channel
+
+  PollState *state = &stateOf(fd);
+  if (state->armed && state->events == channel->events())
+    return; // 关注的事件没有变化，在途的 poll 请求依然有效
+  if (state->armed)
+    cancelPoll(state, fd);
+  markDirty(fd, state);
+}
+
+// 从 IoUringPoller 中删除 channel
+void IoUringPoller::removeChannel(Channel *channel) {
+  const int fd = channel->fd();
+  assert(hasChannel(channel)); // fd 属于当前 loop 的这个 channel
+  LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
+
+  PollState &state = stateOf(fd);
+  if (state.armed)
+    cancelPoll(&state, fd);
+  state.events = 0;
+  state.dirty = false;
+
+  channels_[fd].channel = nullptr;
+  channels_[fd].index = kNew;
+  --numChannels_;
+}
+
+void IoUringPoller::markDirty(int fd, PollState *state) {
+  if (!state->dirty) {
+    state->dirty = true;
+    dirtyFds_.push_back(fd);
+  }
+}
+
+// 注册一个 one-shot 的 poll 请求，fd 就绪或者注册时已就绪都会产生完成事件
+void IoUringPoller::armPoll(int fd, Channel *channel, PollState *state) {
+  if (++nextGen_ == 0) // 序号 0 保留不用
+    ++nextGen_;
+  state->gen = nextGen_;
+  state->events = channel->events();
+  state->armed = true;
+
+  io_uring_sqe *sqe = getSqe();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = static_cast<uint32_t>(state->events);
+  sqe->user_data = encodeUserData(fd, state->gen);
+}
+
+// 撤销在途的 poll 请求，其完成事件(-ECANCELED)会因为 armed 为 false 被忽略
+void IoUringPoller::cancelPoll(PollState *state, int fd) {
+  io_uring_sqe *sqe = getSqe();
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = encodeUserData(fd, state->gen);
+  sqe->user_data = kIgnoreUserData;
+  state->armed = false;
+}
+
+io_uring_sqe *IoUringPoller::getSqe() {
+  unsigned tail = *sqTail_;
+  // SQ 已满，先把积累的请求交给内核，直到内核取走请求腾出空位
+  while (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+    if (!submit(0, 0, false) && errno != EAGAIN && errno != EBUSY)
+      LOG_FATAL("io_uring SQ full, submit error:%d \n", errno);
+    tail = *sqTail_;
+  }
+  const unsigned index = tail & *sqMask_;
+  io_uring_sqe *sqe = &sqes_[index];
+  memset(sqe, 0, sizeof *sqe);
+  sqArray_[index] = index;
+  __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+  ++toSubmit_;
+  return sqe;
+}
+
+// 提交积累的 SQE；wait 为 true 时等待至少 minComplete 个完成事件或者超时
+bool IoUringPoller::submit(unsigned minComplete, int timeoutMs, bool wait) {
+  __kernel_timespec ts;
+  io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof arg);
+  unsigned flags = IORING_ENTER_EXT_ARG;
+  if (wait) {
+    flags |= IORING_ENTER_GETEVENTS;
+    arg.sigmask_sz = _NSIG / 8;
+    if (timeoutMs >= 0) {
+      ts.tv_sec = timeoutMs / 1000;
+      ts.tv_nsec = (timeoutMs % 1000) * 1000 * 1000LL;
+      arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+  } else
+    minComplete = 0;
+
+  int ret = io_uring_enter(ringFd_, toSubmit_, minComplete, flags, &arg,
+                           sizeof arg);
+  if (ret >= 0)
+    toSubmit_ -= std::min(toSubmit_, static_cast<unsigned>(ret));
+  else if (errno != ETIME && errno != EINTR) { // 超时和被信号中断不算错误
+    int saveErrno = errno;
+    LOG_ERROR("io_uring_enter error:%d \n", saveErrno);
+    errno = saveErrno;
+    return false;
+  }
+  return true;
+}
+
+int IoUringPoller::reapCompletions(ChannelList *activeChannels) {
+  int numEvents = 0;
+  unsigned head = *cqHead_;
+  const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+
+  for (; head != tail; ++head) {
+    const io_uring_cqe &cqe = cqes_[head & *cqMask_];
+    if (cqe.user_data == kIgnoreUserData)
+      continue;
+
+    const size_t fd = static_cast<size_t>(cqe.user_data >> 32);
+    const uint32_t gen = static_cast<uint32_t>(cqe.user_data);
+    if (fd >= states_.size())
+      continue;
+    PollState &state = states_[fd];
+    if (!state.armed || state.gen != gen)
+      continue; // 已撤销或者已被新请求替代的 poll 请求
+    state.armed = false;
+
+    Channel *channel = channels_[fd].channel;
+    if (channel == nullptr)
+      continue;
+    if (cqe.res < 0) // poll 请求本身失败，当作 fd 出错交给 channel 处理
+      LOG_ERROR("io_uring poll fd=%lu err:%d \n", fd, -cqe.res);
+    // poll 返回的事件掩码与 epoll 的 EPOLLIN/EPOLLOUT/... 取值相同
+    channel->set_revents(cqe.res < 0 ? POLLERR : cqe.res);
+    activeChannels->push_back(channel);
+    markDirty(static_cast<int>(fd), &state); // one-shot，处理完之后需要重新注册
+    ++numEvents;
+  }
+
+  __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+  return numEvents;
+}
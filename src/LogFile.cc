@@ -0,0 +1,109 @@
+#include "LogFile.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+LogFile::LogFile(const std::string &basename, off_t rollSize,
+                 int flushInterval, int rollInterval, int checkEveryN)
+    : basename_(basename), rollSize_(rollSize), flushInterval_(flushInterval),
+      rollInterval_(rollInterval), checkEveryN_(checkEveryN), count_(0),
+      startOfPeriod_(0), lastRoll_(0), lastFlush_(0), writtenBytes_(0),
+      fp_(nullptr) {
+  rollFile();
+}
+
+LogFile::~LogFile() {
+  if (fp_ != nullptr)
+    ::fclose(fp_);
+}
+
+/* 这里不能使用 LOG_* 宏，否则会递归写回自己；出错时直接写 stderr */
+void LogFile::append(const char *logline, size_t len) {
+  if (fp_ == nullptr)
+    return;
+
+  size_t written = 0;
+  while (written != len) {
+    size_t n = ::fwrite_unlocked(logline + written, 1, len - written, fp_);
+    if (n == 0) {
+      int err = ::ferror(fp_);
+      if (err)
+        fprintf(stderr, "LogFile::append() failed %s\n", strerror(err));
+      break;
+    }
+    written += n;
+  }
+  writtenBytes_ += written;
+
+  if (writtenBytes_ > rollSize_)
+    rollFile();
+  else if (++count_ >= checkEveryN_) {
+    count_ = 0;
+    time_t now = ::time(NULL);
+    time_t thisPeriod = now / rollInterval_ * rollInterval_;
+    if (thisPeriod != startOfPeriod_)
+      rollFile();
+    else if (now - lastFlush_ > flushInterval_) {
+      lastFlush_ = now;
+      ::fflush(fp_);
+    }
+  }
+}
+
+void LogFile::flush() {
+  if (fp_ != nullptr)
+    ::fflush(fp_);
+}
+
+bool LogFile::rollFile() {
+  time_t now = ::time(NULL);
+  if (now <= lastRoll_) // 文件名精确到秒，同一秒内不能再滚动
+    return false;
+
+  std::string filename = getLogFileName(basename_, now);
+  // 'e' 即 O_CLOEXEC
+  FILE *fp = ::fopen(filename.c_str(), "ae");
+  if (fp == nullptr) {
+    fprintf(stderr, "LogFile::rollFile() open %s failed %s\n",
+            filename.c_str(), strerror(errno));
+    return false;
+  }
+
+  if (fp_ != nullptr)
+    ::fclose(fp_);
+  fp_ = fp;
+  ::setbuffer(fp_, buffer_, sizeof buffer_);
+
+  lastRoll_ = now;
+  lastFlush_ = now;
+  startOfPeriod_ = now / rollInterval_ * rollInterval_;
+  writtenBytes_ = 0;
+  count_ = 0;
+  return true;
+}
+
+std::string LogFile::getLogFileName(const std::string &basename, time_t now) {
+  std::string filename;
+  filename.reserve(basename.size() + 64);
+  filename = basename;
+
+  char timebuf[32];
+  struct tm tm;
+  ::localtime_r(&now, &tm);
+  strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.", &tm);
+  filename += timebuf;
+
+  char hostname[256];
+  if (::gethostname(hostname, sizeof hostname) == 0) {
+    hostname[sizeof hostname - 1] = '\0';
+    filename += hostname;
+  } else
+    filename += "unknownhost";
+
+  char pidbuf[32];
+  snprintf(pidbuf, sizeof pidbuf, ".%d", ::getpid());
+  filename += pidbuf;
+  filename += ".log";
+  return filename;
+}
@@ -1,7 +1,23 @@
 #include "Logger.h"
 #include "Timestamp.h"
 
-#include <iostream>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+std::atomic_int Logger::logLevel_(DEBUG);
+
+// 默认输出到 stdout，由 stdio 缓冲，不会每条日志都 flush
+static void defaultOutput(const char *msg, int len) {
+  fwrite(msg, 1, len, stdout);
+}
+
+static void defaultFlush() { fflush(stdout); }
+
+static const char *const kLevelNames[] = {"[DEBUG]", "[INFO]", "[ERROR]",
+                                          "[FATAL]"};
+
+Logger::Logger() : output_(defaultOutput), flush_(defaultFlush) {}
 
 // 获取日志唯一的实例对象
 Logger &Logger::instance() {
@@ -9,29 +25,27 @@ Logger &Logger::instance() {
   return logger;
 }
 
-// 设置日志级别
-void Logger::setLogLevel(int level) { logLevel_ = level; }
-
-// 写日志
-// [级别信息] time : msg
-void Logger::log(std::string msg) {
-  switch (logLevel_) {
-  case INFO:
-    std::cout << "[INFO]";
-    break;
-  case ERROR:
-    std::cout << "[ERROR]";
-    break;
-  case FATAL:
-    std::cout << "[FATAL]";
-    break;
-  case DEBUG:
-    std::cout << "[DEBUG]";
-    break;
-  default:
-    break;
-  }
-
-  // 打印时间和 msg
-  std::cout << Timestamp::now().toString() << " : " << msg << std::endl;
-}
\ No newline at end of file
+/* 写日志
+ * [级别信息] time : msg
+ * 在栈上拼出一整行(不需要清零)，一次交给输出函数，多个线程的日志不会交错 */
+void Logger::logf(LogLevel level, const char *fmt, ...) {
+  char line[1200];
+  const int kMaxLen = sizeof line - 1; // 截断时留一个字节给 '\n'
+  // 在 EventLoop 线程中使用本轮 poll 返回的时间，不再取时间
+  int len = snprintf(line, sizeof line, "%s", kLevelNames[level]);
+  len += Timestamp::cachedNow().formatTo(line + len);
+  memcpy(line + len, " : ", 3);
+  len += 3;
+
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(line + len, sizeof line - len, fmt, args);
+  va_end(args);
+  if (n > 0)
+    len = len + n > kMaxLen ? kMaxLen : len + n;
+
+  line[len++] = '\n';
+  instance().output_(line, len);
+}
+
+void Logger::flush() { flush_(); }
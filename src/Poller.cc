@@ -1,9 +1,9 @@
 #include "Poller.h"
 #include "Channel.h"
 
-Poller::Poller(EventLoop *loop) : ownerLoop_(loop) {}
+Poller::Poller(EventLoop *loop) : numChannels_(0), ownerLoop_(loop) {}
 
 bool Poller::hasChannel(Channel *channel) const {
-  auto it = channels_.find(channel->fd());
-  return it != channels_.end() && it->second == channel;
+  const size_t fd = static_cast<size_t>(channel->fd());
+  return fd < channels_.size() && channels_[fd].channel == channel;
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "SlabPool.h"
+
+#include <new>
+
+SlabPool::SlabPool(size_t maxFreeBlocks)
+    : freeList_(nullptr), freeCount_(0), lowWater_(0),
+      maxFreeBlocks_(maxFreeBlocks), inUse_(0) {}
+
+SlabPool::~SlabPool() {
+  while (freeList_ != nullptr) {
+    FreeBlock *next = freeList_->next;
+    ::operator delete(freeList_);
+    freeList_ = next;
+  }
+}
+
+void *SlabPool::allocate() {
+  ++inUse_;
+  if (freeList_ == nullptr)
+    return ::operator new(kBlockSize);
+
+  FreeBlock *block = freeList_;
+  freeList_ = block->next;
+  if (--freeCount_ < lowWater_)
+    lowWater_ = freeCount_;
+  return block;
+}
+
+void SlabPool::deallocate(void *block) {
+  --inUse_;
+  if (freeCount_ >= maxFreeBlocks_) {
+    ::operator delete(block);
+    return;
+  }
+  FreeBlock *b = static_cast<FreeBlock *>(block);
+  b->next = freeList_;
+  freeList_ = b;
+  ++freeCount_;
+}
+
+/* 整个周期内空闲链表都没有短于 lowWater_，说明这么多 block 一直没被用到
+ * 这里只释放一半，避免周期性的流量刚好在 trim 之后又重新分配 */
+void SlabPool::trim() {
+  size_t n = (lowWater_ + 1) / 2;
+  while (n-- > 0 && freeList_ != nullptr) {
+    FreeBlock *next = freeList_->next;
+    ::operator delete(freeList_);
+    freeList_ = next;
+    --freeCount_;
+  }
+  lowWater_ = freeCount_;
+}
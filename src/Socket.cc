@@ -2,12 +2,17 @@
 #include "InetAddress.h"
 #include "Logger.h"
 
-#include <netinet/tcp.h> // TCP_NODELAY
+#include <errno.h>
+#include <netinet/tcp.h> // TCP_NODELAY, TCP_DEFER_ACCEPT
 #include <strings.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
 Socket::~Socket() { close(sockfd_); }
 
 void Socket::bindAddress(const InetAddress &localaddr) {
@@ -22,11 +27,15 @@ void Socket::listen() {
 }
 
 int Socket::accept(InetAddress *peeraddr) {
+  return accept(peeraddr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+}
+
+int Socket::accept(InetAddress *peeraddr, int flags) {
   sockaddr_in addr;
   socklen_t len = sizeof addr;
   bzero(&addr, sizeof addr);
   int connfd = /* nonblock and I/O multiplexing */
-      ::accept4(sockfd_, (sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      ::accept4(sockfd_, (sockaddr *)&addr, &len, flags);
   if (connfd >= 0)
     peeraddr->setSockAddr(addr);
   return connfd;
@@ -55,4 +64,29 @@ void Socket::setReusePort(bool on) {
 void Socket::setKeepAlive(bool on) {
   int optval = on ? 1 : 0;
   ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
-}
\ No newline at end of file
+}
+
+void Socket::setDeferAccept(int seconds) {
+  if (::setsockopt(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &seconds,
+                   sizeof seconds) < 0)
+    LOG_ERROR("setDeferAccept sockfd:%d seconds:%d error \n", sockfd_,
+              seconds);
+}
+
+bool Socket::setZeroCopy(bool on) {
+  int optval = on ? 1 : 0;
+  // SO_ZEROCOPY 需要 Linux 4.14
+  if (::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof optval) <
+      0) {
+    LOG_ERROR("setZeroCopy sockfd:%d error:%d \n", sockfd_, errno);
+    return false;
+  }
+  return true;
+}
+
+void Socket::setBusyPoll(int usecs) {
+  // 超过 net.core.busy_read 需要 CAP_NET_ADMIN
+  if (::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof usecs) <
+      0)
+    LOG_ERROR("setBusyPoll sockfd:%d usecs:%d error \n", sockfd_, usecs);
+}
@@ -4,13 +4,32 @@
 #include "Logger.h"
 #include "Socket.h"
 
+#include <algorithm>
 #include <errno.h>
+#include <fcntl.h>
 #include <functional>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <string>
 #include <strings.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <unistd.h>
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+static const size_t kMinReadSize = 512;
+static const size_t kMaxReadSize = 64 * 1024;
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop) {
   if (loop == nullptr)
@@ -25,7 +44,14 @@ TcpConnection::TcpConnection(EventLoop *loop, const std::string &nameArg,
     : loop_(CheckLoopNotNull(loop)), name_(nameArg), state_(kConnecting),
       reading_(true), socket_(new Socket(sockfd)),
       channel_(new Channel(loop, sockfd)), localAddr_(localAddr),
-      peerAddr_(peerAddr), highWaterMark_(64 * 1024 * 1024) { // 64M
+      peerAddr_(peerAddr), highWaterMark_(64 * 1024 * 1024), // 64M
+      idleTimeout_(0.0), readTimeout_(0.0), timingWheel_(nullptr),
+      readSize_(Buffer::kInitialSize), readShrinkVotes_(0), outputQueued_(0),
+      outputSent_(0), segmentBytes_(0), shutdownPending_(false),
+      autoCork_(false), flushQueued_(false), readPaused_(false),
+      readDrainCut_(false),
+      pauseReadMark_(0), resumeReadMark_(0), zeroCopyThreshold_(0),
+      zeroCopySeq_(0) {
   channel_->setReadCallback(
       std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
   channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
@@ -39,18 +65,107 @@ TcpConnection::TcpConnection(EventLoop *loop, const std::string &nameArg,
 TcpConnection::~TcpConnection() {
   LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d \n", name_.c_str(),
            channel_->fd(), (int)state_);
+  clearSegments(); // 没有走到 connectDestroyed 的连接
 }
 
+/* 其他线程调用时不能只绑定 buf 的指针，loop 线程执行时 buf 可能已经析构，
+ * functor 持有数据和 TcpConnection 的 shared_ptr */
 void TcpConnection::send(const std::string &buf) {
-  if (state_ == kConnected)
+  if (state_ == kConnected) {
+    if (loop_->isInLoopThread())
+      sendInLoop(buf.data(), buf.size());
+    else
+      loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop,
+                                 shared_from_this(), buf));
+  }
+}
+
+void TcpConnection::send(std::string &&buf) {
+  if (state_ == kConnected) {
+    if (loop_->isInLoopThread())
+      sendInLoop(buf.data(), buf.size());
+    else
+      loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop,
+                                 shared_from_this(), std::move(buf)));
+  }
+}
+
+void TcpConnection::send(const void *data, size_t len) {
+  if (state_ == kConnected) {
     if (loop_->isInLoopThread())
-      sendInLoop(buf.c_str(), buf.size());
+      sendInLoop(data, len);
     else
-      loop_->runInLoop(
-          std::bind(&TcpConnection::sendInLoop, this, buf.c_str(), buf.size()));
+      loop_->runInLoop(std::bind(
+          &TcpConnection::sendStringInLoop, shared_from_this(),
+          std::string(static_cast<const char *>(data), len)));
+  }
+}
+
+void TcpConnection::send(Buffer *buf) {
+  if (state_ == kConnected) {
+    if (loop_->isInLoopThread())
+      sendInLoop(buf->peek(), buf->readableBytes());
+    else if (buf->pool() != nullptr) // 存储属于其他 loop 的 pool，不能带走
+      loop_->runInLoop(std::bind(&TcpConnection::sendBufferInLoop,
+                                 shared_from_this(), Buffer(*buf)));
+    else {
+      Buffer data;
+      data.swap(*buf);
+      loop_->runInLoop(std::bind(&TcpConnection::sendBufferInLoop,
+                                 shared_from_this(), std::move(data)));
+    }
+    buf->retrieveAll();
+  }
+}
+
+void TcpConnection::sendv(const struct iovec *pieces, int count) {
+  if (state_ == kConnected) {
+    if (loop_->isInLoopThread())
+      sendvInLoop(pieces, count, std::shared_ptr<const void>());
+    else {
+      std::string data;
+      for (int i = 0; i < count; ++i)
+        data.append(static_cast<const char *>(pieces[i].iov_base),
+                    pieces[i].iov_len);
+      loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop,
+                                 shared_from_this(), std::move(data)));
+    }
+  }
+}
+
+void TcpConnection::sendv(std::vector<std::string> &&pieces) {
+  if (state_ == kConnected) {
+    auto owned = std::make_shared<std::vector<std::string>>(std::move(pieces));
+    if (loop_->isInLoopThread())
+      sendPiecesInLoop(owned);
+    else
+      loop_->runInLoop(std::bind(&TcpConnection::sendPiecesInLoop,
+                                 shared_from_this(), owned));
+  }
+}
+
+void TcpConnection::sendPiecesInLoop(
+    const std::shared_ptr<std::vector<std::string>> &pieces) {
+  std::vector<struct iovec> vec(pieces->size());
+  for (size_t i = 0; i < pieces->size(); ++i) {
+    vec[i].iov_base = const_cast<char *>((*pieces)[i].data());
+    vec[i].iov_len = (*pieces)[i].size();
+  }
+  sendvInLoop(vec.data(), static_cast<int>(vec.size()), pieces);
 }
 
 void TcpConnection::sendInLoop(const void *data, size_t len) {
+  struct iovec vec;
+  vec.iov_base = const_cast<void *>(data);
+  vec.iov_len = len;
+  sendvInLoop(&vec, 1, std::shared_ptr<const void>());
+}
+
+void TcpConnection::sendvInLoop(const struct iovec *pieces, int count,
+                                const std::shared_ptr<const void> &owner) {
+  size_t len = 0;
+  for (int i = 0; i < count; ++i)
+    len += pieces[i].iov_len;
   ssize_t nwrote = 0;
   size_t remaining = len;
   bool faultError = false;
@@ -60,15 +175,19 @@ void TcpConnection::sendInLoop(const void *data, size_t len) {
     return;
   }
 
-  // channel_ 第一次写数据，且缓冲区没有待发送数据
-  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
-    nwrote = ::write(channel_->fd(), data, len);
+  /* channel_ 第一次写数据，且缓冲区和文件都没有待发送数据；
+   * auto-cork 时先放入 outputBuffer_，本轮事件处理结束后一起发送 */
+  if (!autoCork_ && !channel_->isWriting() && !hasPendingOutput()) {
+    const int kMaxIovecs = ChainBuffer::kMaxIovecs;
+    nwrote = ::writev(channel_->fd(), pieces, std::min(count, kMaxIovecs));
     if (nwrote >= 0) {
+      if (timingWheel_ != nullptr)
+        timingWheel_->touch(&idleEntry_);
       remaining = len - nwrote;
       if (remaining == 0 && writeCompleteCallback_)
         // 既然在这里数据全部发送完成，就不用再给 channel 设置 epollout 事件了
-        loop_->queueInLoop(
-            std::bind(writeCompleteCallback_, shared_from_this()));
+        loop_->queueInLoop(std::bind(&TcpConnection::runWriteCompleteCallback,
+                                     shared_from_this()));
     } else { // nwrote < 0
       nwrote = 0;
       if (errno != EWOULDBLOCK) {
@@ -85,18 +204,254 @@ void TcpConnection::sendInLoop(const void *data, size_t len) {
    *    也就是调用 TcpConnection::handleWrite 方法，
    *    把发送缓冲区中的数据全部发送完成 */
   if (!faultError && remaining > 0) {
-    // 目前发送缓冲区剩余的待发送数据的长度
-    size_t oldLen = outputBuffer_.readableBytes();
+    // 目前剩余的待发送数据的长度，包括文件和内存段
+    size_t oldLen = outputBytes();
     if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ &&
         highWaterMarkCallback_)
       /* 应用写的快，而内核发送数据慢，需要把待发送数据写入缓冲区，
       当缓冲区的数据超过一定的水位时，调用相应回调 */
-      loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(),
-                                   oldLen + remaining));
-    outputBuffer_.append((char *)data + nwrote, remaining);
-    if (!channel_->isWriting())
-      channel_->enableWriting();
+      loop_->queueInLoop(std::bind(&TcpConnection::runHighWaterMarkCallback,
+                                   shared_from_this(), oldLen + remaining));
+    if (!channel_->isWriting()) {
+      if (autoCork_)
+        scheduleFlush();
+      else
+        channel_->enableWriting();
+    }
+
+    // 跳过已经发送的 nwrote 字节，剩下的按顺序排队
+    size_t skip = static_cast<size_t>(nwrote);
+    for (int i = 0; i < count; ++i) {
+      const char *data = static_cast<const char *>(pieces[i].iov_base);
+      size_t n = pieces[i].iov_len;
+      if (skip >= n) {
+        skip -= n;
+        continue;
+      }
+      data += skip;
+      n -= skip;
+      skip = 0;
+      if (owner) { // 不拷贝，由 handleWrite 和 outputBuffer_ 一起 writev
+        OutputSegment segment = {};
+        segment.fd = -1;
+        segment.data = data;
+        segment.remaining = n;
+        segment.owner = owner;
+        queueSegment(segment);
+      } else {
+        outputBuffer_.append(data, n);
+        outputQueued_ += n;
+      }
+    }
+    updateBackpressure();
+  }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length) {
+  if (state_ != kConnected || length == 0)
+    return;
+  int dupfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (dupfd < 0) {
+    LOG_ERROR("TcpConnection::sendFile dup fd=%d errno=%d \n", fd, errno);
+    return;
+  }
+  if (loop_->isInLoopThread())
+    sendFileInLoop(dupfd, offset, length);
+  else
+    loop_->runInLoop(std::bind(&TcpConnection::sendFileInLoop,
+                               shared_from_this(), dupfd, offset, length));
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length) {
+  if (state_ == kDisconnected) {
+    LOG_ERROR("disconnected, give up sending file!");
+    ::close(fd);
+    return;
   }
+
+  OutputSegment segment = {};
+  segment.fd = fd;
+  segment.offset = offset;
+  segment.remaining = length;
+  queueSegment(segment);
+}
+
+void TcpConnection::sendZeroCopy(const void *data, size_t len,
+                                 std::shared_ptr<const void> owner) {
+  if (state_ == kConnected) {
+    if (loop_->isInLoopThread())
+      sendZeroCopyInLoop(data, len, owner);
+    else
+      loop_->runInLoop(std::bind(&TcpConnection::sendZeroCopyInLoop,
+                                 shared_from_this(), data, len,
+                                 std::move(owner)));
+  }
+}
+
+void TcpConnection::sendZeroCopy(
+    const std::shared_ptr<const std::string> &payload) {
+  sendZeroCopy(payload->data(), payload->size(), payload);
+}
+
+void TcpConnection::sendZeroCopyInLoop(
+    const void *data, size_t len, const std::shared_ptr<const void> &owner) {
+  // 小块数据 pin 住内存和处理完成通知的开销比拷贝还大
+  if (zeroCopyThreshold_ == 0 || len <= zeroCopyThreshold_) {
+    sendInLoop(data, len);
+    return;
+  }
+  if (state_ == kDisconnected) {
+    LOG_ERROR("disconnected, give up writing!");
+    return;
+  }
+
+  OutputSegment segment = {};
+  segment.fd = -1;
+  segment.data = static_cast<const char *>(data);
+  segment.remaining = len;
+  segment.owner = owner;
+  segment.zeroCopy = true;
+  queueSegment(segment);
+}
+
+/* segment 记下当前 outputBuffer_ 的追加位置，排在已有数据之后；
+ * 之后 send 的数据追加到 outputBuffer_，由 writeOutput 等它发送完再发 */
+void TcpConnection::queueSegment(const OutputSegment &segment) {
+  segments_.push_back(segment);
+  segments_.back().position = outputQueued_;
+  segmentBytes_ += segment.remaining;
+  updateBackpressure();
+  if (channel_->isWriting())
+    return;
+  if (autoCork_)
+    scheduleFlush();
+  else { // 之前没有待发送的数据，立即尝试发送
+    channel_->enableWriting();
+    handleWrite();
+  }
+}
+
+/* 1. 轮到文件或者零拷贝数据时单独发送
+ * 2. 否则把 outputBuffer_ 中的数据和其间排队的内存段(sendv)按顺序合并，
+ *    一次 writev 发送，遇到文件或零拷贝数据为止 */
+ssize_t TcpConnection::writeOutput(int *savedErrno) {
+  while (!segments_.empty() && segments_.front().position == outputSent_ &&
+         (segments_.front().fd >= 0 || segments_.front().zeroCopy)) {
+    OutputSegment &segment = segments_.front();
+    ssize_t n = writeSegment(&segment, savedErrno);
+    if (n == 0 || segment.remaining == 0) {
+      segmentBytes_ -= segment.remaining; // 文件被截断时剩下的部分
+      if (segment.fd >= 0)
+        ::close(segment.fd);
+      else if (segment.zeroCopied) { // 等内核通知之后才能释放数据
+        zeroCopyPending_.back().sending = false;
+        if (zeroCopyPending_.back().count == 0) // 通知已经全部到达
+          zeroCopyPending_.pop_back();
+      }
+      segments_.pop_front();
+      /* 文件被截断(sendfile 返回 0)时丢掉这一段，接着发送后面的数据；
+       * 否则返回 0 会结束 handleWrite 的循环，边缘触发模式下不会再有
+       * EPOLLOUT，后面的数据一直发不出去 */
+      if (n == 0)
+        continue;
+    }
+    return n;
+  }
+  if (!hasPendingOutput())
+    return 0;
+
+  const int kMaxIovecs = ChainBuffer::kMaxIovecs;
+  struct iovec vec[kMaxIovecs];
+  int iovcnt = 0;
+  uint64_t position = outputSent_; // 已经填入 vec 的 outputBuffer_ 数据的末尾
+  for (auto it = segments_.begin(); iovcnt < kMaxIovecs; ++it) {
+    const uint64_t end = it == segments_.end() ? outputQueued_ : it->position;
+    iovcnt += outputBuffer_.peekIovecs(vec + iovcnt, kMaxIovecs - iovcnt,
+                                       position - outputSent_, end - position);
+    position = end;
+    if (it == segments_.end() || it->fd >= 0 || it->zeroCopy ||
+        iovcnt == kMaxIovecs)
+      break;
+    vec[iovcnt].iov_base = const_cast<char *>(it->data);
+    vec[iovcnt].iov_len = it->remaining;
+    ++iovcnt;
+  }
+
+  ssize_t n = ::writev(channel_->fd(), vec, iovcnt);
+  if (n < 0) {
+    *savedErrno = errno;
+    return n;
+  }
+
+  // 按填入的顺序移除已经发送的数据
+  size_t left = static_cast<size_t>(n);
+  while (left > 0) {
+    const uint64_t end =
+        segments_.empty() ? outputQueued_ : segments_.front().position;
+    const size_t fromBuffer =
+        std::min(left, static_cast<size_t>(end - outputSent_));
+    outputBuffer_.retrieve(fromBuffer); // 从 outputBuffer_ 中移除已经发送的数据
+    outputSent_ += fromBuffer;
+    left -= fromBuffer;
+    if (left == 0)
+      break;
+
+    OutputSegment &segment = segments_.front();
+    const size_t fromSegment = std::min(left, segment.remaining);
+    segment.data += fromSegment;
+    segment.remaining -= fromSegment;
+    segmentBytes_ -= fromSegment;
+    left -= fromSegment;
+    if (segment.remaining == 0)
+      segments_.pop_front();
+  }
+  return n;
+}
+
+ssize_t TcpConnection::writeSegment(OutputSegment *segment, int *savedErrno) {
+  ssize_t n = 0;
+  if (segment->fd >= 0) {
+    const size_t kMaxSendfile = 0x7ffff000; // sendfile 单次最多发送的字节数
+    n = ::sendfile(channel_->fd(), segment->fd, &segment->offset,
+                   std::min(segment->remaining, kMaxSendfile));
+    if (n == 0) // 文件比 length 短，剩下的部分无法发送
+      LOG_ERROR("TcpConnection::sendFile file fd=%d truncated, %zu bytes "
+                "unsent \n",
+                segment->fd, segment->remaining);
+  } else {
+    n = ::send(channel_->fd(), segment->data, segment->remaining,
+               MSG_ZEROCOPY);
+    if (n > 0) {
+      /* 每次成功的 MSG_ZEROCOPY 发送对应一个递增的通知序号，
+       * 通知可能在这一段发送完之前就到达，第一次发送时就开始记录 */
+      if (!segment->zeroCopied) {
+        segment->zeroCopied = true;
+        zeroCopyPending_.push_back(
+            ZeroCopyPending{zeroCopySeq_, 0, 0, true, segment->owner});
+      }
+      ++zeroCopyPending_.back().count;
+      ++zeroCopySeq_;
+    } else if (n < 0 && errno == ENOBUFS) // 未完成的零拷贝超过了 optmem 限制
+      n = ::send(channel_->fd(), segment->data, segment->remaining, 0);
+    if (n > 0)
+      segment->data += n;
+  }
+
+  if (n > 0) {
+    segment->remaining -= n;
+    segmentBytes_ -= n;
+  } else if (n < 0)
+    *savedErrno = errno;
+  return n;
+}
+
+void TcpConnection::clearSegments() {
+  for (const OutputSegment &segment : segments_)
+    if (segment.fd >= 0)
+      ::close(segment.fd);
+  segments_.clear();
+  segmentBytes_ = 0;
+  zeroCopyPending_.clear();
 }
 
 // 关闭连接
@@ -108,16 +463,120 @@ void TcpConnection::shutdown() {
 }
 
 void TcpConnection::shutdownInLoop() {
-  if (!channel_->isWriting()) // 说明 outputBuffer 中的数据已发送完毕
+  if (!hasPendingOutput()) // 说明 outputBuffer 中的数据已发送完毕
     socket_->shutdownWrite(); // 关闭写端
+  else
+    shutdownPending_ = true; // 由 handleWrite 在发送完成后关闭
+}
+
+void TcpConnection::startRead() {
+  loop_->runInLoop(
+      std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop() {
+  if (state_ == kDisconnected) // channel 可能已经从 Poller 中移除
+    return;
+  readPaused_ = false; // 用户的决定优先于自动恢复
+  if (!reading_ || !channel_->isReading()) {
+    channel_->enableReading();
+    reading_ = true;
+    if (timingWheel_ != nullptr && readTimeout_ > 0.0) // 重新开始计算读超时
+      timingWheel_->add(&readEntry_, readTimeout_);
+  }
+  /* 边缘触发模式下暂停时没有读到 EAGAIN，内核中还有数据；同一轮中暂停又
+   * 恢复时 Poller 看到关注的事件没有变化，不会重新注册，也就不会再有新的
+   * 边沿，所以主动补一次读 */
+  if (readDrainCut_ && channel_->isEdgeTriggered()) {
+    readDrainCut_ = false;
+    loop_->queueInLoop(
+        std::bind(&TcpConnection::handleDeferredRead, shared_from_this()));
+  }
+}
+
+void TcpConnection::handleDeferredRead() {
+  if (reading_ && (state_ == kConnected || state_ == kDisconnecting))
+    handleRead(Timestamp::cachedNow());
+}
+
+void TcpConnection::stopRead() {
+  loop_->runInLoop(
+      std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopReadInLoop() {
+  if (state_ == kDisconnected)
+    return;
+  readPaused_ = false; // 用户暂停的，不会被自动恢复
+  if (reading_ || channel_->isReading()) {
+    channel_->disableReading();
+    reading_ = false;
+    // 暂停期间不读数据，不应该因为读超时被关闭
+    if (timingWheel_ != nullptr)
+      timingWheel_->remove(&readEntry_);
+  }
+}
+
+/* 待发送的数据超过 pauseReadMark_ 时暂停读，回落到 resumeReadMark_ 以下时
+ * 恢复；只恢复由这里暂停的读，不改变用户 stopRead 的状态 */
+void TcpConnection::updateBackpressure() {
+  if (pauseReadMark_ == 0 || state_ == kDisconnected)
+    return;
+  const size_t backlog = outputBytes();
+  if (readPaused_) {
+    if (backlog <= resumeReadMark_) {
+      LOG_DEBUG("TcpConnection::resumeRead [%s] backlog=%zu \n",
+                name_.c_str(), backlog);
+      startReadInLoop();
+    }
+  } else if (reading_ && backlog >= pauseReadMark_) {
+    LOG_DEBUG("TcpConnection::pauseRead [%s] backlog=%zu \n", name_.c_str(),
+              backlog);
+    stopReadInLoop();
+    readPaused_ = true;
+  }
+}
+
+// 强制关闭连接，走和对端关闭相同的 handleClose 流程
+void TcpConnection::forceClose() {
+  if (state_ == kConnected || state_ == kDisconnecting) {
+    setState(kDisconnecting);
+    loop_->queueInLoop(
+        std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+  }
+}
+
+void TcpConnection::forceCloseInLoop() {
+  if (state_ == kConnected || state_ == kDisconnecting)
+    handleClose(); // as if we received 0 byte in handleRead();
 }
 
 // 连接建立，会在 TcpServer::newConnection() 中调用
 void TcpConnection::connectEstablished() {
   setState(kConnected);
+  if (zeroCopyThreshold_ > 0 && !socket_->setZeroCopy(true))
+    zeroCopyThreshold_ = 0; // 内核不支持，退化为普通发送
+  // 缓冲区只在有数据时从所属 loop 的 slab pool 中分配
+  inputBuffer_.setPool(loop_->slabPool());
+  outputBuffer_.setPool(loop_->slabPool());
   channel_->tie(shared_from_this());
   channel_->enableReading();
 
+  // 启用了超时的连接挂入所属 loop 的时间轮
+  if (idleTimeout_ > 0.0 || readTimeout_ > 0.0) {
+    timingWheel_ = loop_->timingWheel();
+    if (idleTimeout_ > 0.0) {
+      idleEntry_.setTimeoutCallback(
+          std::bind(&TcpConnection::handleTimeout, this, "idle"));
+      timingWheel_->add(&idleEntry_, idleTimeout_);
+    }
+    if (readTimeout_ > 0.0) {
+      readEntry_.setTimeoutCallback(
+          std::bind(&TcpConnection::handleTimeout, this, "read"));
+      timingWheel_->add(&readEntry_, readTimeout_);
+    }
+  }
+
   connectionCallback_(shared_from_this());
 }
 
@@ -128,52 +587,160 @@ void TcpConnection::connectDestroyed() {
     channel_->disableAll();
     connectionCallback_(shared_from_this());
   }
+  removeTimeouts();
   channel_->remove();
+
+  /* 在 loop 线程中把缓冲区归还给 slab pool，
+   * TcpConnection 可能在其他线程中析构 */
+  inputBuffer_.release();
+  outputBuffer_.retrieveAll();
+  clearSegments();
+}
+
+void TcpConnection::setEdgeTriggered(bool on) {
+  channel_->setEdgeTriggered(on);
 }
 
-// 处理读事件的回调函数
+void TcpConnection::setBusyPoll(int usecs) { socket_->setBusyPoll(usecs); }
+
+/* 处理读事件的回调函数
+ * 边缘触发模式下同一批数据只会通知一次，因此要一直读到 EAGAIN，
+ * 每读到一段数据就交给 onMessage 回调，避免 inputBuffer_ 无限增长 */
 void TcpConnection::handleRead(Timestamp receiveTime) {
+  const bool edgeTriggered = channel_->isEdgeTriggered();
+  ssize_t n = 0;
   int savedErrno = 0;
-  ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+  do {
+    inputBuffer_.ensureWriteableBytes(readSize_);
+    n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    if (n > 0) { // 已建立连接的用户发生可读事件，调用用户传入的 onMessage 回调
+      adjustReadSize(static_cast<size_t>(n));
+      if (timingWheel_ != nullptr) { // O(1)，只刷新截止时间
+        timingWheel_->touch(&idleEntry_);
+        timingWheel_->touch(&readEntry_);
+      }
+      messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+      /* 读取量已经回落，还有半条消息时也缩回去，不一直占着高峰期的内存
+       * 不超过一个 block 的存储来自 slab pool，不需要缩 */
+      if (inputBuffer_.internalCapacity() > SlabPool::kBlockSize &&
+          inputBuffer_.writableBytes() >= 4 * readSize_)
+        inputBuffer_.shrink(readSize_);
+    }
+  } while (edgeTriggered && n > 0 && state_ != kDisconnected && reading_);
+  // 边缘触发模式下因为暂停读而没有读到 EAGAIN，恢复时需要补一次读
+  readDrainCut_ = edgeTriggered && n > 0 && !reading_;
 
-  if (n > 0) // 已建立连接的用户发生可读事件，调用用户传入的 onMessage 回调
-    messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
-  else if (n == 0) // 如果读取的数据长度为 0，表示客户端连接已关闭
+  /* 把为这次读取预留的存储归还给 slab pool；
+   * messageCallback_ 已经返回，不会再有指向其中的指针 */
+  if (inputBuffer_.readableBytes() == 0)
+    inputBuffer_.release();
+
+  if (n == 0) // 如果读取的数据长度为 0，表示客户端连接已关闭
     handleClose();
-  else { // 如果读取的数据长度小于 0，表示发生了错误
+  else if (n < 0 && !(edgeTriggered && savedErrno == EAGAIN)) {
+    // 如果读取的数据长度小于 0，表示发生了错误
     errno = savedErrno;
     LOG_ERROR("TcpConnection::handleRead");
     handleError();
   }
 }
 
+/* 与 netty 的 AdaptiveRecvByteBufAllocator 类似：
+ * 读满预留的空间说明还有数据，立即翻倍，下次直接读进 inputBuffer_，
+ * 不再经过 extrabuf 再 append 拷贝一次；偶尔一次小读不会马上缩小 */
+void TcpConnection::adjustReadSize(size_t n) {
+  if (n >= readSize_) {
+    readSize_ = std::min(readSize_ * 2, kMaxReadSize);
+    readShrinkVotes_ = 0;
+  } else if (n <= readSize_ / 4 && readSize_ > kMinReadSize) {
+    if (++readShrinkVotes_ >= 2) {
+      readSize_ = std::max(readSize_ / 2, kMinReadSize);
+      readShrinkVotes_ = 0;
+    }
+  } else
+    readShrinkVotes_ = 0;
+}
+
 void TcpConnection::handleWrite() {
   if (channel_->isWriting()) {
+    ssize_t n = 0;
     int savedErrno = 0;
-    ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
-    if (n > 0) {
-      outputBuffer_.retrieve(n); // 从 outputBuffer_ 中移除已经发送的数据
-      if (outputBuffer_.readableBytes() == 0) { // 发送完成
-        channel_->disableWriting();             // 不再关注 POLLOUT 事件
-        if (writeCompleteCallback_)
-          loop_->queueInLoop(
-              std::bind(writeCompleteCallback_, shared_from_this()));
-        if (state_ == kDisconnecting)
-          shutdownInLoop();
-      }
-    } else
+    bool wrote = false;
+    do { // 边缘触发模式下一直写到数据和文件都发送完或者 EAGAIN
+      n = writeOutput(&savedErrno);
+      if (n > 0)
+        wrote = true;
+    } while (channel_->isEdgeTriggered() && n > 0 && hasPendingOutput());
+
+    if (wrote && timingWheel_ != nullptr)
+      timingWheel_->touch(&idleEntry_);
+    if (!hasPendingOutput()) // 发送完成
+      outputDrained();
+    else if (!wrote && !(n < 0 && savedErrno == EAGAIN))
       LOG_ERROR("TcpConnection::handleWrite");
+    if (wrote)
+      updateBackpressure();
   } else
     LOG_ERROR("TcpConnection fd=%d is down, no more writing \n",
               channel_->fd());
 }
 
+/* auto-cork：本轮 send 的数据在事件处理结束后一起发送，写到 EAGAIN 为止，
+ * 没有发完的再注册 EPOLLOUT 交给 handleWrite */
+void TcpConnection::flushOutput() {
+  flushQueued_ = false;
+  if (state_ == kDisconnected || channel_->isWriting() || !hasPendingOutput())
+    return;
+
+  ssize_t n = 0;
+  int savedErrno = 0;
+  bool wrote = false;
+  do {
+    n = writeOutput(&savedErrno);
+    if (n > 0)
+      wrote = true;
+  } while (n > 0 && hasPendingOutput());
+
+  if (wrote && timingWheel_ != nullptr)
+    timingWheel_->touch(&idleEntry_);
+  if (!hasPendingOutput())
+    outputDrained();
+  else {
+    if (n < 0 && savedErrno != EAGAIN)
+      LOG_ERROR("TcpConnection::flushOutput");
+    channel_->enableWriting();
+  }
+  if (wrote)
+    updateBackpressure();
+}
+
+void TcpConnection::scheduleFlush() {
+  if (!flushQueued_) { // 一轮只提交一次
+    flushQueued_ = true;
+    loop_->queueFlush(
+        std::bind(&TcpConnection::flushOutput, shared_from_this()));
+  }
+}
+
+void TcpConnection::outputDrained() {
+  if (channel_->isWriting())
+    channel_->disableWriting(); // 不再关注 POLLOUT 事件
+  if (writeCompleteCallback_)
+    loop_->queueInLoop(std::bind(&TcpConnection::runWriteCompleteCallback,
+                                 shared_from_this()));
+  if (shutdownPending_) {
+    shutdownPending_ = false;
+    socket_->shutdownWrite();
+  }
+}
+
 // poller => channel::closeCallback => TcpConnection::handleClose
 void TcpConnection::handleClose() {
   LOG_INFO("TcpConnection::handleClose fd=%d state=%d \n", channel_->fd(),
            (int)state_);
   setState(kDisconnected);
   channel_->disableAll();
+  removeTimeouts();
 
   TcpConnectionPtr connPtr(shared_from_this());
   connectionCallback_(connPtr); // 执行连接 建立/关闭 的回调
@@ -182,6 +749,9 @@ void TcpConnection::handleClose() {
 }
 
 void TcpConnection::handleError() {
+  if (zeroCopyThreshold_ > 0 && handleZeroCopyCompletions())
+    return;
+
   int optval;
   socklen_t optlen = sizeof optval;
   int err = 0;
@@ -191,4 +761,73 @@ void TcpConnection::handleError() {
     err = optval;
   LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n",
             name_.c_str(), err);
+}
+
+/* 零拷贝的完成通知通过 socket 的错误队列送达，会触发 EPOLLERR
+ * 每条通知是一个序号区间 [ee_info, ee_data]，多次发送的通知可能被合并 */
+bool TcpConnection::handleZeroCopyCompletions() {
+  bool onlyCompletions = true;
+  bool any = false;
+  char control[128];
+  for (;;) {
+    struct msghdr msg = {};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+    if (::recvmsg(channel_->fd(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+      break; // EAGAIN，错误队列已经读空
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+        continue;
+      const struct sock_extended_err *serr =
+          reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cm));
+      if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0) {
+        onlyCompletions = false;
+        continue;
+      }
+      any = true;
+      // 回环等不支持零拷贝的设备上内核会退化为拷贝，通知中带有 COPIED 标志
+      if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+        LOG_DEBUG("TcpConnection::handleZeroCopyCompletions [%s] copied \n",
+                  name_.c_str());
+      completeZeroCopy(serr->ee_info, serr->ee_data);
+    }
+  }
+  return any && onlyCompletions;
+}
+
+/* 序号区间 [lo, hi] 的发送已经完成，序号是 32 位回绕的
+ * 已经发送完并且所有通知都到达的数据释放 owner */
+void TcpConnection::completeZeroCopy(uint32_t lo, uint32_t hi) {
+  for (auto it = zeroCopyPending_.begin(); it != zeroCopyPending_.end();) {
+    const int64_t first = static_cast<int32_t>(lo - it->firstSeq);
+    const int64_t last = static_cast<int32_t>(hi - it->firstSeq);
+    const int64_t sent = it->count + it->completed;
+    const int64_t overlap = std::min<int64_t>(last, sent - 1) -
+                            std::max<int64_t>(first, 0) + 1;
+    if (overlap > 0) {
+      it->count -= static_cast<uint32_t>(overlap);
+      it->completed += static_cast<uint32_t>(overlap);
+    }
+    if (it->count == 0 && !it->sending)
+      it = zeroCopyPending_.erase(it); // 释放 owner
+    else
+      ++it;
+  }
+}
+
+// 时间轮到期，批量回调，逐个走正常的关闭流程
+void TcpConnection::handleTimeout(const char *what) {
+  LOG_INFO("TcpConnection::handleTimeout [%s] %s timeout \n", name_.c_str(),
+           what);
+  forceCloseInLoop();
+}
+
+void TcpConnection::removeTimeouts() {
+  if (timingWheel_ != nullptr) {
+    timingWheel_->remove(&idleEntry_);
+    timingWheel_->remove(&readEntry_);
+  }
 }
\ No newline at end of file
@@ -3,7 +3,9 @@
 #include "TcpConnection.h"
 
 #include <functional>
+#include <future>
 #include <strings.h>
+#include <sys/socket.h>
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop) {
   if (!loop)
@@ -19,18 +21,48 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop) {
  */
 TcpServer::TcpServer(EventLoop *loop, const InetAddress &listenAddr,
                      const std::string &nameArg, Option option)
-    : loop_(CheckLoopNotNull(loop)), ipPort_(listenAddr.toIpPort()),
-      name_(nameArg),
-      acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+    : loop_(CheckLoopNotNull(loop)), listenAddr_(listenAddr),
+      ipPort_(listenAddr.toIpPort()), name_(nameArg), option_(option),
+      acceptor_(option == kReusePortPerLoop
+                    ? nullptr
+                    : new Acceptor(loop, listenAddr, option == kReusePort)),
       threadPool_(new EventLoopThreadPool(loop, name_)), connectionCallback_(),
-      messageCallback_(), nextConnId_(1), started_(0) {
+      messageCallback_(), nextConnId_(1), started_(0), edgeTriggered_(false),
+      idleTimeout_(0.0), readTimeout_(0.0), busyPollSpins_(0),
+      busyPollUsecs_(0), busyPollBudget_(0), zeroCopyThreshold_(0),
+      autoCork_(false), pauseReadMark_(0), resumeReadMark_(0),
+      acceptBatch_(Acceptor::kDefaultAcceptBatch),
+      acceptFlags_(SOCK_NONBLOCK | SOCK_CLOEXEC), deferAcceptSeconds_(0) {
   // 当有先用户连接时，会执行 TcpServer::newConnection
-  acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this,
-                                                std::placeholders::_1,
-                                                std::placeholders::_2));
+  if (acceptor_)
+    acceptor_->setNewConnectionCallback(
+        std::bind(&TcpServer::newConnection, this, std::placeholders::_1,
+                  std::placeholders::_2));
 }
 
 TcpServer::~TcpServer() {
+  /* io loop 的 Acceptor 要在各自的线程中析构(从 Poller 中移除 channel)，
+   * 并且要等它析构完，之后不会再回调 newConnectionInLoop。io loop 归
+   * threadPool_ 所有，析构函数执行期间一直存在 */
+  for (std::unique_ptr<Acceptor> &acceptor : loopAcceptors_) {
+    EventLoop *ioLoop = acceptor->getLoop();
+    std::promise<void> done;
+    Acceptor *raw = acceptor.release();
+    ioLoop->runInLoop([this, ioLoop, raw, &done] {
+      delete raw;
+      /* 这个 loop 上的连接关闭时会在本线程直接回调 removeConnection，
+       * 换成空操作，避免之后访问已经析构的 TcpServer；
+       * 留在 connections_ 中的连接由下面统一销毁 */
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto &item : connections_)
+        if (item.second->getLoop() == ioLoop)
+          item.second->setCloseCallback([](const TcpConnectionPtr &) {});
+      done.set_value();
+    });
+    done.get_future().wait();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
   for (auto &item : connections_) {
     // 这个局部的 shared_ptr 智能指针对象，出右括号，
     // 可以自动释放 new 出来的 TcpConnection 对象资源
@@ -50,21 +82,61 @@ void TcpServer::setThreadNum(int numThreads) {
 // 开启服务器监听
 void TcpServer::start() {
   if (started_++ == 0) { // 防止一个 TcpServer 对象被 start 多次
-    threadPool_->start(threadInitCallback_); // 启动底层的 loop 线程池
-    loop_->runInLoop(/* bind() 依托于对象，所以需要 get() */
-                     std::bind(&Acceptor::listen, acceptor_.get()));
+    // 启动底层的 loop 线程池
+    threadPool_->start(
+        std::bind(&TcpServer::initLoop, this, std::placeholders::_1));
+    if (acceptor_) {
+      configureAcceptor(acceptor_.get());
+      loop_->runInLoop(/* bind() 依托于对象，所以需要 get() */
+                       std::bind(&Acceptor::listen, acceptor_.get()));
+    } else {
+      InetAddress addr = listenAddr_;
+      // 没有 subloop 时 getAllLoops() 只有 mainLoop，即只有一个 Acceptor
+      for (EventLoop *ioLoop : threadPool_->getAllLoops()) {
+        std::unique_ptr<Acceptor> acceptor(new Acceptor(ioLoop, addr, true));
+        /* 端口为 0 时每个 socket 都会分到不同的端口，
+         * 其余的 Acceptor 绑定第一个分到的端口 */
+        if (addr.toPort() == 0) {
+          addr = acceptor->localAddress();
+          ipPort_ = addr.toIpPort();
+        }
+        configureAcceptor(acceptor.get());
+        acceptor->setNewConnectionCallback(
+            std::bind(&TcpServer::newConnectionInLoop, this, ioLoop,
+                      std::placeholders::_1, std::placeholders::_2));
+        ioLoop->runInLoop(std::bind(&Acceptor::listen, acceptor.get()));
+        loopAcceptors_.push_back(std::move(acceptor));
+      }
+    }
   }
 }
 
+void TcpServer::configureAcceptor(Acceptor *acceptor) {
+  acceptor->setAcceptBatch(acceptBatch_);
+  acceptor->setAcceptFlags(acceptFlags_);
+  acceptor->setDeferAccept(deferAcceptSeconds_);
+}
+
+void TcpServer::initLoop(EventLoop *loop) {
+  if (busyPollSpins_ > 0)
+    loop->setSpinPolls(busyPollSpins_);
+  if (busyPollUsecs_ > 0)
+    loop->setKernelBusyPoll(busyPollUsecs_, busyPollBudget_);
+  if (threadInitCallback_)
+    threadInitCallback_(loop);
+}
+
 // 当有一个新的客户端连接时，acceptor 会调用这个回调函数
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr) {
   // 使用轮询算法，从线程池中选择一个事件循环（EventLoop）来管理新的 channel
-  EventLoop *ioLoop = threadPool_->getNextLoop();
+  newConnectionInLoop(threadPool_->getNextLoop(), sockfd, peerAddr);
+}
 
+void TcpServer::newConnectionInLoop(EventLoop *ioLoop, int sockfd,
+                                    const InetAddress &peerAddr) {
   // 生成一个新的连接名称，用于标识新的连接
   char buf[64] = {0};
-  snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-  ++nextConnId_;
+  snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_++);
   std::string connName = name_ + buf;
 
   LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s \n",
@@ -81,11 +153,22 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr) {
   // 根据连接成功的 sockfd，创建 TcpConnection 对象
   TcpConnectionPtr conn(
       new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-  connections_[connName] = conn;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections_[connName] = conn;
+  }
 
   conn->setConnectionCallback(connectionCallback_);
   conn->setMessageCallback(messageCallback_);
   conn->setWriteCompleteCallback(writeCompleteCallback_);
+  conn->setEdgeTriggered(edgeTriggered_);
+  conn->setIdleTimeout(idleTimeout_);
+  conn->setReadTimeout(readTimeout_);
+  if (busyPollUsecs_ > 0)
+    conn->setBusyPoll(busyPollUsecs_);
+  conn->setZeroCopyThreshold(zeroCopyThreshold_);
+  conn->setAutoCork(autoCork_);
+  conn->setBackpressure(pauseReadMark_, resumeReadMark_);
 
   conn->setCloseCallback(
       std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
@@ -94,19 +177,26 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr) {
    *   1. 将 channel 和 TcpConnection 绑定
    *   2. 启用 channel 的读事件
    *   3. 调用 connectionCallback_ 回调函数
-   */
+   * kReusePortPerLoop 模式下已经在 ioLoop 中，直接执行 */
   ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr &conn) {
-  loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+  if (option_ == kReusePortPerLoop) // 在连接自己的 loop 中移除，不经过 mainLoop
+    removeConnectionInLoop(conn);
+  else
+    loop_->runInLoop(
+        std::bind(&TcpServer::removeConnectionInLoop, this, conn));
 }
 
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn) {
   LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n",
            name_.c_str(), conn->name().c_str());
 
-  connections_.erase(conn->name());
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections_.erase(conn->name());
+  }
   EventLoop *ioLoop = conn->getLoop();
   ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
 }
\ No newline at end of file
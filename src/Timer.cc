@@ -0,0 +1,7 @@
+#include "Timer.h"
+
+std::atomic<int64_t> Timer::s_numCreated_(0);
+
+void Timer::restart(Timestamp now) {
+  expiration_ = repeat_ ? addTime(now, interval_) : Timestamp::invalid();
+}
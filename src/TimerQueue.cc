@@ -0,0 +1,193 @@
+#include "TimerQueue.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Timer.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// 创建一个 timerfd，使用单调时钟，并设置为 nonblock 和 close-on-exec
+static int createTimerfd() {
+  int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timerfd < 0)
+    LOG_FATAL("timerfd_create error:%d \n", errno);
+  return timerfd;
+}
+
+// 计算 when 距离现在的时间，至少 100 微秒，避免设置为 0 导致 timerfd 停止
+static struct timespec howMuchTimeFromNow(Timestamp when) {
+  int64_t microseconds =
+      when.microSecondsSinceEpoch() - Timestamp::now().microSecondsSinceEpoch();
+  if (microseconds < 100)
+    microseconds = 100;
+  struct timespec ts;
+  ts.tv_sec =
+      static_cast<time_t>(microseconds / Timestamp::kMicroSecondsPerSecond);
+  ts.tv_nsec = static_cast<long>(
+      (microseconds % Timestamp::kMicroSecondsPerSecond) * 1000);
+  return ts;
+}
+
+// timerfd 可读之后必须把到期次数读出来，否则水平触发会一直通知
+static void readTimerfd(int timerfd) {
+  uint64_t howmany;
+  ssize_t n = ::read(timerfd, &howmany, sizeof howmany);
+  if (n != sizeof howmany)
+    LOG_ERROR("TimerQueue::handleRead() reads %ld bytes instead of 8 \n", n);
+}
+
+TimerQueue::TimerQueue(EventLoop *loop)
+    : loop_(loop), timerfd_(createTimerfd()), timerfdChannel_(loop, timerfd_),
+      armedExpiration_(0) {
+  timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
+  // we are always reading the timerfd, we disarm it with timerfd_settime.
+  timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue() {
+  timerfdChannel_.disableAll();
+  timerfdChannel_.remove();
+  ::close(timerfd_);
+  for (auto &item : activeTimers_)
+    delete item.second;
+}
+
+TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when,
+                             double interval) {
+  Timer *timer = new Timer(std::move(cb), when, interval);
+  // 在 loop 线程中调用时直接插入，不需要 wakeup
+  loop_->runInLoop(std::bind(&TimerQueue::addTimerInLoop, this, timer));
+  return TimerId(timer->sequence());
+}
+
+void TimerQueue::cancel(TimerId timerId) {
+  loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId));
+}
+
+void TimerQueue::addTimerInLoop(Timer *timer) {
+  activeTimers_[timer->sequence()] = timer;
+  heapPush(timer);
+  if (heap_[0].timer == timer) // 最早到期的定时器发生了变化
+    resetTimerfd(timer->expiration());
+}
+
+/* 1. 定时器还在堆中，直接从堆中删除并释放
+ * 2. 定时器已经到期(正在执行回调)，只从 activeTimers_ 中删除，
+ *    handleRead 不会再执行它，也不会再重新插入，由 handleRead 负责释放 */
+void TimerQueue::cancelInLoop(TimerId timerId) {
+  auto it = activeTimers_.find(timerId.sequence_);
+  if (it == activeTimers_.end())
+    return; // 已经到期释放，或者已经取消
+
+  Timer *timer = it->second;
+  activeTimers_.erase(it);
+  if (timer->heapIndex() != Timer::kNotInHeap) {
+    heapRemove(timer->heapIndex());
+    delete timer;
+  }
+}
+
+/*
+ * 1. 取出所有到期的定时器
+ * 2. 依次执行回调，回调中取消的定时器不再执行
+ * 3. 重复定时器重新插入堆中，其余的释放，最后按新的堆顶设置 timerfd
+ */
+void TimerQueue::handleRead() {
+  readTimerfd(timerfd_);
+  // timerfd 到期之后 poll 才会返回，本轮 poll 返回的时间不早于堆顶的到期时间
+  Timestamp now(Timestamp::cachedNow());
+  armedExpiration_ = 0;
+
+  expired_.clear();
+  while (!heap_.empty() && heap_[0].when <= now.microSecondsSinceEpoch()) {
+    expired_.push_back(heap_[0].timer);
+    heapRemove(0);
+  }
+
+  for (Timer *timer : expired_)
+    if (activeTimers_.count(timer->sequence()))
+      timer->run();
+
+  for (Timer *timer : expired_) {
+    auto it = activeTimers_.find(timer->sequence());
+    if (it != activeTimers_.end() && timer->repeat()) {
+      timer->restart(now);
+      heapPush(timer);
+    } else {
+      if (it != activeTimers_.end())
+        activeTimers_.erase(it);
+      delete timer;
+    }
+  }
+  expired_.clear();
+
+  if (!heap_.empty())
+    resetTimerfd(Timestamp(heap_[0].when));
+}
+
+void TimerQueue::heapPush(Timer *timer) {
+  heap_.push_back(Entry{timer->expiration().microSecondsSinceEpoch(), timer});
+  timer->set_heapIndex(heap_.size() - 1);
+  siftUp(heap_.size() - 1);
+}
+
+void TimerQueue::heapRemove(size_t index) {
+  heap_[index].timer->set_heapIndex(Timer::kNotInHeap);
+  const size_t last = heap_.size() - 1;
+  if (index != last) { // 用最后一个节点填补空位，再向上或向下调整
+    heapSet(index, heap_[last]);
+    heap_.pop_back();
+    siftDown(index);
+    siftUp(index);
+  } else
+    heap_.pop_back();
+}
+
+void TimerQueue::siftUp(size_t index) {
+  Entry entry = heap_[index];
+  while (index > 0) {
+    size_t parent = (index - 1) / 2;
+    if (heap_[parent].when <= entry.when)
+      break;
+    heapSet(index, heap_[parent]);
+    index = parent;
+  }
+  heapSet(index, entry);
+}
+
+void TimerQueue::siftDown(size_t index) {
+  Entry entry = heap_[index];
+  const size_t size = heap_.size();
+  while (true) {
+    size_t child = index * 2 + 1;
+    if (child >= size)
+      break;
+    if (child + 1 < size && heap_[child + 1].when < heap_[child].when)
+      ++child;
+    if (entry.when <= heap_[child].when)
+      break;
+    heapSet(index, heap_[child]);
+    index = child;
+  }
+  heapSet(index, entry);
+}
+
+void TimerQueue::heapSet(size_t index, const Entry &entry) {
+  heap_[index] = entry;
+  entry.timer->set_heapIndex(index);
+}
+
+// 重新设置 timerfd 的到期时间，与当前设置相同时省去一次系统调用
+void TimerQueue::resetTimerfd(Timestamp expiration) {
+  if (expiration.microSecondsSinceEpoch() == armedExpiration_)
+    return;
+  armedExpiration_ = expiration.microSecondsSinceEpoch();
+
+  struct itimerspec newValue;
+  memset(&newValue, 0, sizeof newValue);
+  newValue.it_value = howMuchTimeFromNow(expiration);
+  if (::timerfd_settime(timerfd_, 0, &newValue, NULL) != 0)
+    LOG_ERROR("timerfd_settime error:%d \n", errno);
+}
@@ -1,5 +1,7 @@
 #include "Timestamp.h"
 
+#include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 // Timestamp 类的默认构造函数，初始化微秒数为 0
@@ -10,21 +12,70 @@ Timestamp::Timestamp() : microSecondsSinceEpoch_(0) {}
 Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
     : microSecondsSinceEpoch_(microSecondsSinceEpoch) {}
 
+namespace {
+
+__thread int64_t t_cachedNow = 0; // 本线程 EventLoop 缓存的时间，0 表示没有
+
+/* 本线程上次格式化的日期前缀 "YYYY/MM/DD HH:MM:"，按分钟缓存
+ * 时区偏移都是整分钟，同一分钟内只需要重新格式化秒和微秒 */
+__thread int64_t t_cachedMinute = -1;
+__thread char t_datePrefix[Timestamp::kFormattedSize];
+__thread int t_datePrefixLen = 0;
+
+} // namespace
+
 // 静态成员函数，返回当前时间的 Timestamp 对象
-// 这里使用 time(NULL) 获取当前时间的秒数，并转换为 Timestamp 对象
-Timestamp Timestamp::now() { return Timestamp(time(NULL)); }
+// clock_gettime 走 vDSO，不陷入内核，精度为微秒，定时器依赖这一精度
+Timestamp Timestamp::now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond +
+                   ts.tv_nsec / 1000);
+}
+
+Timestamp Timestamp::cachedNow() {
+  return t_cachedNow > 0 ? Timestamp(t_cachedNow) : now();
+}
+
+void Timestamp::setCachedNow(Timestamp now) {
+  t_cachedNow = now.microSecondsSinceEpoch();
+}
 
 // 将 Timestamp 对象转换为字符串表示形式
-// 返回格式: "YYYY/MM/DD HH:MM:SS"
+// 返回格式: "YYYY/MM/DD HH:MM:SS.uuuuuu"
 std::string Timestamp::toString() const {
-  char buf[128] = {0};
-  // 将微秒数转换为 time_t 类型，然后转换为 tm 结构体表示本地时间
-  tm *tm_time = localtime(&microSecondsSinceEpoch_);
-  // 格式化时间为字符串
-  snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d", tm_time->tm_year + 1900,
-           tm_time->tm_mon + 1, tm_time->tm_mday, tm_time->tm_hour,
-           tm_time->tm_min, tm_time->tm_sec);
-  return buf;
+  char buf[kFormattedSize];
+  int len = formatTo(buf);
+  return std::string(buf, len);
+}
+
+int Timestamp::formatTo(char *buf) const {
+  int64_t seconds = microSecondsSinceEpoch_ / kMicroSecondsPerSecond;
+  int microseconds =
+      static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+  if (microseconds < 0) { // 1970 年之前的时间
+    --seconds;
+    microseconds += kMicroSecondsPerSecond;
+  }
+
+  const int64_t minute = seconds >= 0 ? seconds / 60 : (seconds - 59) / 60;
+  if (minute != t_cachedMinute) {
+    // 将秒数转换为 time_t 类型，然后转换为 tm 结构体表示本地时间
+    time_t t = static_cast<time_t>(minute * 60);
+    struct tm tm_time;
+    localtime_r(&t, &tm_time);
+    t_datePrefixLen =
+        snprintf(t_datePrefix, sizeof t_datePrefix, "%4d/%02d/%02d %02d:%02d:",
+                 tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+                 tm_time.tm_hour, tm_time.tm_min);
+    t_cachedMinute = minute;
+  }
+
+  memcpy(buf, t_datePrefix, t_datePrefixLen);
+  int len = t_datePrefixLen;
+  len += snprintf(buf + len, kFormattedSize - len, "%02d.%06d",
+                  static_cast<int>(seconds - minute * 60), microseconds);
+  return len;
 }
 
 /* 测试代码 */
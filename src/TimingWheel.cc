@@ -0,0 +1,89 @@
+#include "TimingWheel.h"
+#include "EventLoop.h"
+
+#include <math.h>
+
+TimingWheel::TimingWheel(EventLoop *loop, double tickSeconds,
+                         size_t numBuckets)
+    : loop_(loop), tickSeconds_(tickSeconds), buckets_(numBuckets, nullptr),
+      currentTick_(0), size_(0) {
+  tickTimer_ =
+      loop_->runEvery(tickSeconds_, std::bind(&TimingWheel::onTick, this));
+}
+
+TimingWheel::~TimingWheel() {
+  loop_->cancel(tickTimer_);
+  for (Entry *head : buckets_)
+    for (Entry *entry = head; entry != nullptr; entry = entry->next_)
+      entry->bucket_ = Entry::kNotLinked;
+}
+
+/* 截止 tick 多加 1，因为当前 tick 已经过去了一部分，
+ * 这样保证至少经过 timeoutSeconds 才会超时 */
+void TimingWheel::add(Entry *entry, double timeoutSeconds) {
+  if (entry->linked())
+    unlink(entry);
+  entry->timeoutTicks_ =
+      static_cast<int64_t>(ceil(timeoutSeconds / tickSeconds_)) + 1;
+  touch(entry);
+  link(entry, entry->deadline_ % buckets_.size());
+}
+
+void TimingWheel::remove(Entry *entry) {
+  if (entry->linked())
+    unlink(entry);
+}
+
+void TimingWheel::link(Entry *entry, size_t bucket) {
+  entry->bucket_ = bucket;
+  entry->prev_ = nullptr;
+  entry->next_ = buckets_[bucket];
+  if (entry->next_ != nullptr)
+    entry->next_->prev_ = entry;
+  buckets_[bucket] = entry;
+  ++size_;
+}
+
+void TimingWheel::unlink(Entry *entry) {
+  if (entry->prev_ != nullptr)
+    entry->prev_->next_ = entry->next_;
+  else
+    buckets_[entry->bucket_] = entry->next_;
+  if (entry->next_ != nullptr)
+    entry->next_->prev_ = entry->prev_;
+  entry->prev_ = entry->next_ = nullptr;
+  entry->bucket_ = Entry::kNotLinked;
+  --size_;
+}
+
+/*
+ * 1. 摘下当前槽位的整条链表
+ * 2. 截止 tick 还没到的 entry(期间被 touch 过，或者超时时长超过一圈)，
+ *    重新挂到截止 tick 对应的槽位
+ * 3. 到期的 entry 收集起来，最后统一回调
+ */
+void TimingWheel::onTick() {
+  ++currentTick_;
+  const size_t bucket = currentTick_ % buckets_.size();
+  Entry *entry = buckets_[bucket];
+  buckets_[bucket] = nullptr;
+
+  expired_.clear();
+  while (entry != nullptr) {
+    Entry *next = entry->next_;
+    --size_;
+    if (entry->deadline_ > currentTick_)
+      link(entry, entry->deadline_ % buckets_.size());
+    else {
+      entry->prev_ = entry->next_ = nullptr;
+      entry->bucket_ = Entry::kNotLinked;
+      expired_.push_back(entry);
+    }
+    entry = next;
+  }
+
+  for (Entry *expired : expired_)
+    if (expired->callback_)
+      expired->callback_();
+  expired_.clear();
+}
@@ -0,0 +1,21 @@
+#include "BinaryLogging.h"
+
+#include <stdio.h>
+
+// 把 BinaryLogging 写的二进制日志还原为文本，输出到 stdout
+// 使用方法: logdecode server.blog [more.blog ...]
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <binary log file>...\n", argv[0]);
+    return 1;
+  }
+
+  int ret = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (!BinaryLogging::decode(argv[i], stdout)) {
+      fprintf(stderr, "%s: cannot decode %s\n", argv[0], argv[i]);
+      ret = 1;
+    }
+  }
+  return ret;
+}